@@ -0,0 +1,319 @@
+// scale-bench: Run CallGraphPass over synthetic kernel-like modules built in
+// memory and report the time of every phase, to see how the pass scales.
+//
+// Each module has handler functions of one type, *_operations tables of
+// them, global function pointers set statically and at init time, and a
+// dispatcher called with handlers as arguments. Every handler calls other
+// handlers directly (in its module and in others), through a table field,
+// through a global function pointer and through the dispatcher.
+//
+// usage: scale-bench [options] [calls...]   (default: 1000 10000 100000 1000000)
+//
+// Each size is the number of call sites to generate; the functions per
+// module follow from it unless -functions is given.
+
+#include "Analyzer.h"
+#include "CallGraphPass.h"
+#include "Stats.h"
+
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace llvm;
+
+cl::list<unsigned> Sizes(cl::Positional, cl::desc("<calls>..."));
+
+cl::opt<unsigned> NumModules("modules", cl::desc("Number of modules"), cl::init(64));
+
+cl::opt<unsigned> FunctionsPerModule(
+    "functions", cl::desc("Handler functions per module (0 = derived from the size)"), cl::init(0));
+
+cl::opt<unsigned> DirectCalls("direct-calls", cl::desc("Direct calls per handler"), cl::init(4));
+
+cl::opt<unsigned> OpsTables("ops-tables", cl::desc("*_operations tables per module"), cl::init(8));
+
+cl::opt<unsigned> OpsTypes(
+    "ops-types", cl::desc("Distinct *_operations struct types shared by all modules"), cl::init(16));
+
+cl::opt<unsigned> GlobalFPs("global-fps", cl::desc("Global function pointer variables per module"),
+                            cl::init(8));
+
+cl::opt<bool> FPArgs("fp-args", cl::desc("Pass handlers to a dispatcher as arguments"), cl::init(true));
+
+cl::opt<unsigned> NumThreads("j", cl::desc("Threads for collecting modules (0 = all cores)"), cl::init(1));
+
+cl::opt<unsigned> Seed("seed", cl::desc("Seed of the generator"), cl::init(1));
+
+// Fields of every *_operations struct
+static const unsigned NumOps = 4;
+
+struct GeneratedModule {
+    std::unique_ptr<LLVMContext> Context;
+    std::unique_ptr<Module> M;
+    std::string Name;
+};
+
+// Name of handler F of module M
+static std::string HandlerName(unsigned M, unsigned F) {
+    return "m" + std::to_string(M) + "_fn" + std::to_string(F);
+}
+
+// Call sites of one handler
+static unsigned CallsPerHandler() {
+    return DirectCalls + (OpsTables ? 1 : 0) + (GlobalFPs ? 1 : 0) + (FPArgs ? 1 : 0);
+}
+
+class ModuleGenerator {
+    public:
+        ModuleGenerator(unsigned Index, unsigned NumFunctions, GeneratedModule &Out)
+            : Index(Index), NumFunctions(NumFunctions), Rand(Seed * 1000003 + Index),
+              Context(*Out.Context) {
+            Out.M.reset(new Module(Out.Name, Context));
+            M = Out.M.get();
+        }
+
+        void Generate();
+
+    private:
+        Function *Handler(unsigned ModuleIndex, unsigned F);
+        void SetLine(IRBuilder<> &Builder, DISubprogram *SP) {
+            Builder.SetCurrentDebugLocation(DILocation::get(Context, ++Line, 0, SP));
+        }
+        DISubprogram *AddSubprogram(DIBuilder &DIB, Function *F);
+        void GenerateTables();
+        void GenerateGlobalFPs(DIBuilder &DIB);
+        void GenerateDispatcher(DIBuilder &DIB);
+        void GenerateHandler(DIBuilder &DIB, unsigned F);
+
+        unsigned Index;
+        unsigned NumFunctions;
+        std::mt19937 Rand;
+        LLVMContext &Context;
+        Module *M;
+
+        DIFile *File = nullptr;
+        DISubroutineType *SubTy = nullptr;
+        unsigned Line = 0;
+
+        FunctionType *OpTy = nullptr;                // i32 (i8*, i32)
+        std::vector<StructType *> OpsStructTypes;    // struct.ops<k>_operations
+        std::vector<GlobalVariable *> TablePtrs;     // struct.ops<k>_operations *m<M>_ops<t>_ptr
+        std::vector<GlobalVariable *> Hooks;         // i32 (i8*, i32)* m<M>_hook<g>
+        Function *Dispatch = nullptr;
+};
+
+// Handler F of module ModuleIndex, declared if it lives in another module
+Function *ModuleGenerator::Handler(unsigned ModuleIndex, unsigned F) {
+    return cast<Function>(M->getOrInsertFunction(HandlerName(ModuleIndex, F), OpTy).getCallee());
+}
+
+DISubprogram *ModuleGenerator::AddSubprogram(DIBuilder &DIB, Function *F) {
+    // The function starts on a line of its own, which is also its scope line
+    ++Line;
+    DISubprogram *SP = DIB.createFunction(File, F->getName(), F->getName(), File, Line, SubTy, Line,
+                                          DINode::FlagZero, DISubprogram::SPFlagDefinition);
+    F->setSubprogram(SP);
+    return SP;
+}
+
+// Tables are initialized with the module's handlers, round robin, and
+// reached through a pointer variable the way dev->ops is
+void ModuleGenerator::GenerateTables() {
+    for (unsigned t = 0; t < OpsTables; ++t) {
+        StructType *ST = OpsStructTypes[(Index * OpsTables + t) % OpsStructTypes.size()];
+        std::vector<Constant *> Fields;
+        for (unsigned k = 0; k < NumOps; ++k)
+            Fields.push_back(Handler(Index, (t * NumOps + k) % NumFunctions));
+
+        std::string Name = "m" + std::to_string(Index) + "_ops" + std::to_string(t);
+        auto *Table = new GlobalVariable(*M, ST, true, GlobalValue::InternalLinkage,
+                                         ConstantStruct::get(ST, Fields), Name);
+        TablePtrs.push_back(new GlobalVariable(*M, ST->getPointerTo(), false, GlobalValue::InternalLinkage,
+                                               Table, Name + "_ptr"));
+    }
+}
+
+// Even hooks are initialized statically, odd ones by the module's init function
+void ModuleGenerator::GenerateGlobalFPs(DIBuilder &DIB) {
+    if (!GlobalFPs)
+        return;
+
+    PointerType *OpPtrTy = OpTy->getPointerTo();
+    for (unsigned g = 0; g < GlobalFPs; ++g) {
+        Constant *Init = g % 2 ? Constant::getNullValue(OpPtrTy) : (Constant *)Handler(Index, g % NumFunctions);
+        Hooks.push_back(new GlobalVariable(*M, OpPtrTy, false, GlobalValue::InternalLinkage, Init,
+                                           "m" + std::to_string(Index) + "_hook" + std::to_string(g)));
+    }
+
+    Function *Init = Function::Create(FunctionType::get(Type::getVoidTy(Context), false),
+                                      GlobalValue::ExternalLinkage, "m" + std::to_string(Index) + "_init", M);
+    DISubprogram *SP = AddSubprogram(DIB, Init);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", Init));
+    for (unsigned g = 1; g < GlobalFPs; g += 2) {
+        SetLine(Builder, SP);
+        Builder.CreateStore(Handler(Index, (g * 7) % NumFunctions), Hooks[g]);
+    }
+    Builder.CreateRetVoid();
+}
+
+// i32 m<M>_dispatch(i32 (i8*, i32)* cb, i8* data, i32 n) { return cb(data, n); }
+void ModuleGenerator::GenerateDispatcher(DIBuilder &DIB) {
+    if (!FPArgs)
+        return;
+
+    Type *Int32Ty = Type::getInt32Ty(Context);
+    FunctionType *DispatchTy =
+        FunctionType::get(Int32Ty, {OpTy->getPointerTo(), Type::getInt8PtrTy(Context), Int32Ty}, false);
+    Dispatch = Function::Create(DispatchTy, GlobalValue::InternalLinkage,
+                                "m" + std::to_string(Index) + "_dispatch", M);
+    DISubprogram *SP = AddSubprogram(DIB, Dispatch);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", Dispatch));
+    SetLine(Builder, SP);
+    Value *Result = Builder.CreateCall(OpTy, Dispatch->getArg(0), {Dispatch->getArg(1), Dispatch->getArg(2)});
+    Builder.CreateRet(Result);
+}
+
+void ModuleGenerator::GenerateHandler(DIBuilder &DIB, unsigned F) {
+    Function *Fn = Handler(Index, F);
+    DISubprogram *SP = AddSubprogram(DIB, Fn);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "entry", Fn));
+    Value *Data = Fn->getArg(0);
+    Value *N = Fn->getArg(1);
+    Value *Sum = N;
+
+    // Mostly calls within the module, like most kernel calls
+    for (unsigned c = 0; c < DirectCalls; ++c) {
+        unsigned Target = Rand() % 4 == 0 ? Rand() % NumModules : Index;
+        SetLine(Builder, SP);
+        Sum = Builder.CreateAdd(Sum, Builder.CreateCall(Handler(Target, Rand() % NumFunctions), {Data, N}));
+    }
+
+    if (OpsTables) {
+        // ops = m<M>_ops<t>_ptr; ops->op<k>(data, n)
+        GlobalVariable *TablePtr = TablePtrs[Rand() % TablePtrs.size()];
+        auto *ST = cast<StructType>(TablePtr->getValueType()->getPointerElementType());
+        SetLine(Builder, SP);
+        Value *Ops = Builder.CreateLoad(TablePtr->getValueType(), TablePtr);
+        Value *Field = Builder.CreateStructGEP(ST, Ops, Rand() % NumOps);
+        Value *Op = Builder.CreateLoad(OpTy->getPointerTo(), Field);
+        Sum = Builder.CreateAdd(Sum, Builder.CreateCall(OpTy, Op, {Data, N}));
+    }
+
+    if (GlobalFPs) {
+        GlobalVariable *Hook = Hooks[Rand() % Hooks.size()];
+        SetLine(Builder, SP);
+        Value *Op = Builder.CreateLoad(Hook->getValueType(), Hook);
+        Sum = Builder.CreateAdd(Sum, Builder.CreateCall(OpTy, Op, {Data, N}));
+    }
+
+    if (FPArgs) {
+        SetLine(Builder, SP);
+        Value *Callback = Handler(Index, Rand() % NumFunctions);
+        Sum = Builder.CreateAdd(Sum, Builder.CreateCall(Dispatch, {Callback, Data, N}));
+    }
+
+    Builder.CreateRet(Sum);
+}
+
+void ModuleGenerator::Generate() {
+    DIBuilder DIB(*M);
+    File = DIB.createFile(M->getName(), "/scale-bench");
+    DIB.createCompileUnit(dwarf::DW_LANG_C99, File, "scale-bench", false, "", 0);
+    SubTy = DIB.createSubroutineType(DIB.getOrCreateTypeArray({}));
+    M->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+
+    Type *Int32Ty = Type::getInt32Ty(Context);
+    OpTy = FunctionType::get(Int32Ty, {Type::getInt8PtrTy(Context), Int32Ty}, false);
+    // Struct types are matched by name across modules
+    for (unsigned k = 0; k < std::max(1u, (unsigned)OpsTypes); ++k) {
+        std::vector<Type *> Fields(NumOps, OpTy->getPointerTo());
+        OpsStructTypes.push_back(StructType::create(Context, Fields, "struct.ops" + std::to_string(k) + "_operations"));
+    }
+
+    GenerateTables();
+    GenerateGlobalFPs(DIB);
+    GenerateDispatcher(DIB);
+    for (unsigned F = 0; F < NumFunctions; ++F)
+        GenerateHandler(DIB, F);
+
+    DIB.finalize();
+}
+
+static double Seconds(std::chrono::steady_clock::time_point Start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+static int Run(unsigned Calls) {
+    unsigned NumFunctions = FunctionsPerModule;
+    if (!NumFunctions)
+        NumFunctions = std::max(1u, Calls / (NumModules * CallsPerHandler()));
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<GeneratedModule> Generated(NumModules);
+    ModuleList Modules;
+    for (unsigned i = 0; i < NumModules; ++i) {
+        GeneratedModule &G = Generated[i];
+        G.Name = "m" + std::to_string(i) + ".c";
+        G.Context.reset(new LLVMContext());
+        ModuleGenerator(i, NumFunctions, G).Generate();
+        Modules.push_back(std::make_pair(G.M.get(), StringRef(G.Name)));
+    }
+    double generateTime = Seconds(start);
+
+    Stats.Reset();
+    start = std::chrono::steady_clock::now();
+    {
+        CallGraphPass Pass("CallGraphPass", NumThreads);
+        Pass.setDumpCallGraph(false);
+        Pass.run(Modules);
+    }
+    double passTime = Seconds(start);
+
+    std::cout << "call sites: " << (uint64_t)NumModules * NumFunctions * CallsPerHandler()
+              << "  modules: " << NumModules << "  functions/module: " << NumFunctions
+              << "  graph: " << Stats.Get(StatGraphFunctions) << " functions, " << Stats.Get(StatGraphEdges)
+              << " edges (" << Stats.Get(StatIndirectResolved) << " indirect calls resolved, "
+              << Stats.Get(StatIndirectUnresolved) << " unresolved)" << std::endl;
+    std::cout << "  generate: " << generateTime << "s  pass: " << passTime << "s  peak RSS: "
+              << RunStats::PeakRSS() << " kB" << std::endl;
+
+    // Per-module phases are summed over modules
+    for (const RunStats::PhaseTotal &Phase : Stats.Phases()) {
+        std::cout << "    " << std::left << std::setw(28) << Phase.Name << std::right << std::setw(12)
+                  << std::fixed << std::setprecision(3) << Phase.Ms << " ms";
+        if (Phase.Count > 1)
+            std::cout << " (" << Phase.Count << "x)";
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    if (!Stats.Get(StatGraphEdges)) {
+        std::cerr << "error: the pass produced no call graph" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    cl::ParseCommandLineOptions(argc, argv, "CallGraphPass scaling benchmark\n");
+
+    std::vector<unsigned> Calls(Sizes.begin(), Sizes.end());
+    if (Calls.empty())
+        Calls = {1000, 10000, 100000, 1000000};
+    if (!NumModules) {
+        std::cerr << "error: -modules must be at least 1" << std::endl;
+        return 1;
+    }
+
+    int ret = 0;
+    for (unsigned N : Calls)
+        ret |= Run(N);
+    return ret;
+}
@@ -1,48 +1,403 @@
+#include "llvm/Support/BuryPointer.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "Analyzer.h"
 #include "CallGraphPass.h"
+#include "FactCache.h"
+#include "GraphExport.h"
+#include "GraphFile.h"
+#include "Logger.h"
+#include "Stats.h"
+#include "PathQuery.h"
+#include "Reachability.h"
 
 #include <chrono>
 #include <iostream>
 
 using namespace llvm;
 cl::list<std::string> InputFilenames(
-    cl::Positional, cl::OneOrMore, cl::desc("<input bitcode files>"));
+    cl::Positional, cl::ZeroOrMore, cl::desc("<input bitcode files>"));
+
+cl::opt<unsigned> NumThreads(
+    "j", cl::desc("Number of threads used to load and analyze bitcode files (0 = all cores)"),
+    cl::value_desc("N"), cl::init(1));
+
+cl::opt<std::string> PathFrom(
+    "from", cl::desc("Print call paths starting at this function"), cl::value_desc("function"));
+
+cl::opt<std::string> PathTo(
+    "to", cl::desc("Print call paths ending at this function"), cl::value_desc("function"));
+
+cl::opt<unsigned> MaxDepth(
+    "max-depth", cl::desc("Maximum number of calls on a path (0 = unlimited)"), cl::init(0));
+
+cl::opt<unsigned> MaxPaths(
+    "max-paths", cl::desc("Number of simple paths to enumerate, shortest first"), cl::init(1));
+
+cl::opt<unsigned> QueryTimeout(
+    "query-timeout", cl::desc("Stop enumerating paths after this many milliseconds (0 = unlimited)"),
+    cl::value_desc("ms"), cl::init(0));
+
+cl::opt<std::string> ReachQueries(
+    "reach-queries",
+    cl::desc("Build a reachability index and answer the \"from to\" function pairs in this file, "
+             "one per line ('-' for stdin)"),
+    cl::value_desc("file"));
+
+cl::opt<std::string> SaveGraph(
+    "save-graph", cl::desc("Write the resolved call graph to a graph file"), cl::value_desc("file"));
+
+cl::opt<std::string> LoadGraph(
+    "load-graph", cl::desc("Answer path queries from a graph file instead of analyzing bitcode"),
+    cl::value_desc("file"));
+
+cl::opt<std::string> OutputFile(
+    "o", cl::desc("Write the resolved call graph to this file ('-' for stdout)"), cl::value_desc("file"));
+
+cl::opt<ExportFormat> OutputFormat(
+    "output-format", cl::desc("Format of the call graph written with -o"), cl::init(ExportFormat::JSONLines),
+    cl::values(
+        clEnumValN(ExportFormat::Text, "text", "Caller, callee, line and kind per edge, tab separated"),
+        clEnumValN(ExportFormat::JSONLines, "jsonl", "One JSON object per edge"),
+        clEnumValN(ExportFormat::DOT, "dot", "Graphviz digraph"),
+        clEnumValN(ExportFormat::GraphML, "graphml", "GraphML document")));
+
+cl::opt<bool> Condense(
+    "condense", cl::desc("Collapse call cycles into single scc#N nodes for -o and -from/-to"));
+
+cl::opt<std::string> SCCMembers(
+    "scc-members", cl::desc("Write the functions of every call cycle to this file as JSON Lines"),
+    cl::value_desc("file"));
+
+cl::opt<std::string> CacheDir(
+    "cache-dir", cl::desc("Reuse facts of unchanged bitcode files from this directory"),
+    cl::value_desc("dir"));
+
+cl::opt<bool> Stream(
+    "stream", cl::desc("Load bitcode lazily, one module at a time, and free each module once collected"));
+
+cl::opt<LogLevel> LogLevelOpt(
+    "log-level", cl::desc("Most verbose messages to print"), cl::init(LogLevel::Warning),
+    cl::values(
+        clEnumValN(LogLevel::Error, "error", "Errors only"),
+        clEnumValN(LogLevel::Warning, "warning", "Errors and warnings"),
+        clEnumValN(LogLevel::Info, "info", "Progress of the analysis"),
+        clEnumValN(LogLevel::Debug, "debug", "Every recorded fact and resolution")));
+
+cl::bits<LogCategory> LogCategories(
+    "log-category", cl::desc("Only print info and debug messages of these categories (default: all)"),
+    cl::CommaSeparated,
+    cl::values(
+        clEnumValN(LogCollect, "collect", "Facts recorded while walking modules"),
+        clEnumValN(LogResolve, "resolve", "Indirect call resolution"),
+        clEnumValN(LogGraph, "graph", "Compact call graph construction"),
+        clEnumValN(LogDump, "dump", "Dumps of the collected facts")));
+
+cl::opt<std::string> StatsFile(
+    "stats-report", cl::desc("Write phase timings and counters as JSON"), cl::value_desc("file"));
+
+cl::opt<std::string> TraceFile(
+    "chrome-trace", cl::desc("Write phase timings as a Chrome trace-event file"), cl::value_desc("file"));
+
+cl::opt<unsigned> MaxSignatureTargets(
+    "max-signature-targets",
+    cl::desc("Resolve an otherwise unresolved indirect call to the address-taken functions of its "
+             "type if there are at most N of them (0 = never)"),
+    cl::value_desc("N"), cl::init(64));
 
 ModuleList Modules;
 
+// Result of loading a single bitcode file.
+// Each file is parsed in its own LLVMContext, so the slots can be filled
+// concurrently and are only read back once the pool has drained.
+struct LoadResult {
+    Module *M = nullptr;
+    bool Cached = false;          // Facts are in the fact cache; the file was not parsed
+    std::string Error;
+};
+
+static void LoadModule(const std::string &Filename, FactCache *Cache, LoadResult &Result) {
+    if (Cache && Cache->Probe(Filename)) {
+        Result.Cached = true;
+        return;
+    }
+
+    ScopedTimer Timer("LoadModule", Filename);
+
+    SMDiagnostic Err;
+    llvm::LLVMContext *context = new llvm::LLVMContext();
+    std::unique_ptr<Module> M = parseIRFile(Filename, Err, *context);
+    if (!M) {
+        raw_string_ostream OS(Result.Error);
+        Err.print("kanalyzer", OS);
+        delete context;
+        return;
+    }
+
+    Result.M = M.release();
+}
+
+// Write the -stats-report and -chrome-trace files, if requested
+static bool WriteStatsFiles() {
+    std::string Error;
+    if (!StatsFile.empty() && !Stats.WriteReport(StatsFile, Error)) {
+        std::cerr << "Error writing stats file: " << StatsFile << ": " << Error << std::endl;
+        return false;
+    }
+    if (!TraceFile.empty() && !Stats.WriteTrace(TraceFile, Error)) {
+        std::cerr << "Error writing trace file: " << TraceFile << ": " << Error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Write Graph to the -o file, if any
+static bool ExportGraph(const CompactCallGraph &Graph) {
+    if (OutputFile.empty())
+        return true;
+
+    ScopedTimer Timer("ExportGraph");
+    std::string Error;
+    if (!ExportCallGraphFile(Graph, OutputFormat, OutputFile, Error)) {
+        std::cerr << "Error writing output file: " << OutputFile << ": " << Error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Answer the -reach-queries file, if any, on Graph
+static bool RunReachability(const CompactCallGraph &Graph) {
+    if (ReachQueries.empty())
+        return true;
+
+    ReachabilityIndex Index;
+    {
+        ScopedTimer Timer("BuildReachIndex");
+        Index.Build(Graph, NumThreads);
+
+        const CondensedCallGraph &DAG = Index.getCondensation();
+        LOG_INFO(LogGraph) << "Reachability index: " << DAG.NumComponents() << " components, "
+                           << DAG.NumEdges() << " condensed edges, " << Index.MemoryUsage()
+                           << " bytes, built in " << Timer.ElapsedMs() << " ms";
+        Stats.Add(StatReachComponents, DAG.NumComponents());
+        Stats.Add(StatReachIndexBytes, Index.MemoryUsage());
+    }
+
+    ScopedTimer Timer("ReachQueries");
+    std::string Error;
+    bool Read = RunReachQueries(Index, Graph, ReachQueries, outs(), Error);
+    outs().flush();
+    Stats.Add(StatReachQueries, Index.NumQueries());
+    Stats.Add(StatReachSearches, Index.NumSearches());
+    if (!Read) {
+        std::cerr << "Error reading reachability queries: " << ReachQueries << ": " << Error << std::endl;
+        return false;
+    }
+
+    LOG_INFO(LogGraph) << Index.NumQueries() << " reachability queries, "
+                       << Index.NumSearches() << " answered by search";
+    return true;
+}
+
+// Answer the -from/-to query, if any, on Graph or, with -condense, on its
+// condensation
+static bool RunQuery(const CompactCallGraph &Graph, const CondensedCallGraph &DAG,
+                     const CompactCallGraph &Condensed, const PathQueryOptions &Options) {
+    if (PathFrom.empty())
+        return true;
+
+    ScopedTimer Timer("PathQuery");
+    if (Condense)
+        return RunCondensedPathQuery(Graph, DAG, Condensed, PathFrom, PathTo, Options, std::cout);
+    return RunPathQuery(Graph, PathFrom, PathTo, Options, std::cout);
+}
+
+// Find the cycles of Graph for -condense and -scc-members and write the
+// -scc-members file
+static bool CondenseGraph(const CompactCallGraph &Graph, CondensedCallGraph &DAG,
+                          CompactCallGraph &Condensed) {
+    if (!Condense && SCCMembers.empty())
+        return true;
+
+    {
+        ScopedTimer Timer("Condense");
+        DAG.Build(Graph, NumThreads);
+        if (Condense)
+            DAG.BuildCallGraph(Graph, Condensed);
+
+        size_t CycleFunctions = 0, Largest = 0;
+        for (ComponentID C = 0; C < DAG.NumComponents(); ++C) {
+            if (!DAG.IsCycle(C))
+                continue;
+            CycleFunctions += DAG.Members(C).size();
+            Largest = std::max(Largest, DAG.Members(C).size());
+        }
+        LOG_INFO(LogGraph) << "Condensed call graph: " << DAG.NumComponents() << " components, "
+                           << DAG.NumCycles() << " cycles of " << CycleFunctions << " functions (largest "
+                           << Largest << "), " << DAG.NumEdges() << " edges in " << Timer.ElapsedMs() << " ms";
+        Stats.Add(StatCycles, DAG.NumCycles());
+        Stats.Add(StatCycleFunctions, CycleFunctions);
+    }
+
+    if (SCCMembers.empty())
+        return true;
+
+    std::string Error;
+    if (!ExportComponentsFile(Graph, DAG, SCCMembers, Error)) {
+        std::cerr << "Error writing cycle file: " << SCCMembers << ": " << Error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Everything done with the final graph, analyzed or loaded. Returns the exit
+// code.
+static int UseGraph(const CompactCallGraph &Graph, const PathQueryOptions &Options) {
+    CondensedCallGraph DAG;
+    CompactCallGraph Condensed;
+    if (!CondenseGraph(Graph, DAG, Condensed))
+        return 1;
+
+    if (!ExportGraph(Condense ? Condensed : Graph) || !RunReachability(Graph))
+        return 1;
+
+    bool Found = RunQuery(Graph, DAG, Condensed, Options);
+    return WriteStatsFiles() && Found ? 0 : 1;
+}
+
 int main(int argc, char **argv) 
 {
 	auto start = std::chrono::system_clock::now();
 
     llvm::cl::ParseCommandLineOptions(argc, argv, "global analysis\n");
 
-    std::cout << "Total " << InputFilenames.size() << " file(s)" << std::endl;
+    CurrentLogLevel = LogLevelOpt;
+    if (LogCategories.getBits())
+        EnabledLogCategories = LogCategories.getBits();
 
-    SMDiagnostic Err;
-    for (unsigned i = 0; i < InputFilenames.size(); ++i) {
-        std::cout << "File " << i + 1 << ": " << InputFilenames[i] << std::endl;
+    if (PathFrom.empty() != PathTo.empty()) {
+        std::cerr << "Path queries need both -from and -to" << std::endl;
+        return 1;
+    }
+
+    if (OutputFormat.getNumOccurrences() && OutputFile.empty()) {
+        std::cerr << "-output-format needs an output file (-o)" << std::endl;
+        return 1;
+    }
+
+    PathQueryOptions Options;
+    Options.MaxDepth = MaxDepth;
+    Options.MaxPaths = MaxPaths;
+    Options.TimeBudgetMs = QueryTimeout;
 
-		llvm::LLVMContext *context = new llvm::LLVMContext();
-        std::unique_ptr<Module> M = parseIRFile(InputFilenames[i], Err, *context);
-        if (!M) {
+    // Query mode: map a saved graph and skip the analysis altogether
+    if (!LoadGraph.empty()) {
+        if (!InputFilenames.empty()) {
+            std::cerr << "-load-graph does not take input bitcode files" << std::endl;
+            return 1;
+        }
+
+        std::string Error;
+        std::unique_ptr<GraphFile> File;
+        {
+            ScopedTimer Timer("LoadGraph");
+            File = GraphFile::Open(LoadGraph, Error);
+        }
+        if (!File) {
+            std::cerr << "Error reading graph file: " << LoadGraph << ": " << Error << std::endl;
+            return 1;
+        }
+
+        const CompactCallGraph &Graph = File->getGraph();
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now() - start);
+        LOG_INFO(LogGraph) << "Loaded graph file " << LoadGraph << ": " << Graph.NumFunctions() << " functions, "
+                           << Graph.NumEdges() << " edges, " << File->NumSymbols() << " symbols, "
+                           << File->Settings().size() << " function pointer settings in "
+                           << elapsed.count() / 1000.0 << " ms";
+
+        return UseGraph(Graph, Options);
+    }
+
+    if (InputFilenames.empty()) {
+        std::cerr << "No input bitcode files" << std::endl;
+        return 1;
+    }
+
+    LOG_INFO(LogCollect) << "Total " << InputFilenames.size() << " file(s)";
+
+    std::unique_ptr<FactCache> Cache;
+    if (!CacheDir.empty()) {
+        std::string Error;
+        Cache.reset(new FactCache(CacheDir));
+        if (!Cache->Init(Error)) {
+            std::cerr << "Error creating fact cache: " << CacheDir << ": " << Error << std::endl;
+            return 1;
+        }
+    }
+
+    // Parse all inputs on a thread pool. Results are stored by input index
+    // so ModuleList keeps the command line order regardless of which file
+    // finishes first. When streaming, nothing is parsed here; the pass loads
+    // each module itself when it gets to it.
+    std::vector<LoadResult> Results(InputFilenames.size());
+    if (!Stream) {
+        ThreadPool Pool(hardware_concurrency(NumThreads));
+        for (unsigned i = 0; i < InputFilenames.size(); ++i) {
+            LOG_INFO(LogCollect) << "File " << i + 1 << ": " << InputFilenames[i];
+            Pool.async(LoadModule, std::cref(InputFilenames[i]), Cache.get(), std::ref(Results[i]));
+        }
+        Pool.wait();
+    }
+
+    // Report parse errors after loading so they are not interleaved.
+    for (unsigned i = 0; i < InputFilenames.size(); ++i) {
+        if (!Stream && !Results[i].M && !Results[i].Cached) {
             std::cerr << "Error reading file: " << InputFilenames[i] << std::endl;
+            std::cerr << Results[i].Error;
             continue;
         }
 
-        Module *Module = M.release();
         StringRef ModuleName = StringRef(strdup(InputFilenames[i].data()));
-        Modules.push_back(std::make_pair(Module, ModuleName));
+        Modules.push_back(std::make_pair(Results[i].M, ModuleName));
     }
 
-    CallGraphPass CGPass("CallGraphPass");
-	CGPass.run(Modules);
+    // Like the modules, the pass and its facts are left to the process exit
+    // rather than freed piece by piece. BuryPointer() keeps them reachable
+    // for leak checkers.
+    std::unique_ptr<CallGraphPass> Pass(new CallGraphPass("CallGraphPass", NumThreads));
+    CallGraphPass &CGPass = *Pass;
+    BuryPointer(std::move(Pass));
+    CGPass.setStreaming(Stream);
+    CGPass.setMaxSignatureTargets(MaxSignatureTargets);
+    // An exported graph replaces the dump
+    CGPass.setDumpCallGraph(OutputFile.empty());
+	CGPass.run(Modules, Cache.get());
+
+    if (Cache) {
+        Stats.Add(StatCacheHits, Cache->Hits());
+        Stats.Add(StatCacheMisses, Cache->Misses());
+        LOG_INFO(LogCollect) << "Fact cache: " << Cache->Hits() << " hit(s), " << Cache->Misses() << " miss(es)";
+    }
+
+    if (!SaveGraph.empty()) {
+        ScopedTimer Timer("SaveGraph");
+        std::string Error;
+        if (!SaveGraphFile(SaveGraph, CGPass.getCompactCallGraph(),
+                           CGPass.getFacts().FunctionPointerSettings, Error)) {
+            std::cerr << "Error writing graph file: " << SaveGraph << ": " << Error << std::endl;
+            return 1;
+        }
+        LOG_INFO(LogGraph) << "Wrote graph file " << SaveGraph;
+    }
 
-	return 0;
-}
\ No newline at end of file
+    return UseGraph(CGPass.getCompactCallGraph(), Options);
+}
@@ -6,111 +6,460 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/User.h"
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/InstVisitor.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include <iostream>
 #include <list>
 
+#include "FactCache.h"
+#include "FactIndex.h"
+#include "Logger.h"
+#include "PointerFlow.h"
+#include "Stats.h"
 #include "Utils.h"
 
 using namespace llvm;
 
 
 
-void CallGraphPass::run(ModuleList &modules) {
-    std::cout << "Running pass: " << ID << std::endl;
+void CallGraphPass::run(ModuleList &modules, FactCache *Cache) {
+    LOG_INFO(LogCollect) << "Running pass: " << ID;
+
+    // Each module is collected into its own shard, interning into a symbol
+    // table of its own. Shards are merged in input order, and their symbols
+    // interned into Symbols as they are, so the parallel and serial runs
+    // assign the same IDs and produce identical facts.
+    std::vector<ModuleFacts> Shards(modules.size());
+    std::vector<std::unique_ptr<SymbolTable>> ShardSymbols(modules.size());
+    std::vector<char> Collected(modules.size(), 0);
+
+    // Intern module names up front so module IDs, and with them the order of
+    // the module-keyed maps, follow the input order even when collecting in parallel.
+    for (auto &entry : modules)
+        Intern(entry.second);
+
+    // A module listed without IR is restored from the cache (already probed
+    // unless streaming) or, when streaming, loaded lazily. An entry that can
+    // no longer be loaded counts as a miss and the bitcode is parsed after
+    // all. A module loaded here and its context are freed before the worker
+    // takes the next input.
+    auto Collect = [this, &modules, &Shards, &ShardSymbols, Cache](size_t i) {
+        Module *M = modules[i].first;
+        StringRef Filename = modules[i].second;
+        ShardSymbols[i].reset(new SymbolTable());
+        ScopedSymbolTable Local(*ShardSymbols[i]);
+        if (!M && Cache && (!Streaming || Cache->Probe(Filename))) {
+            ScopedTimer Timer("LoadCachedFacts", Filename);
+            if (Cache->Load(Filename, Shards[i]))
+                return true;
+
+            LOG_WARNING(LogCollect) << "Cannot load fact cache entry for module: " << Filename
+                                    << "; parsing it instead";
+        }
+
+        std::unique_ptr<LLVMContext> Context;
+        std::unique_ptr<Module> Loaded;
+        if (!M) {
+            ScopedTimer Timer("LoadModule", Filename);
+            SMDiagnostic Err;
+            Context.reset(new LLVMContext());
+            if (Streaming)
+                Loaded = getLazyIRFileModule(Filename, Err, *Context);
+            else
+                Loaded = parseIRFile(Filename, Err, *Context);
+            if (!Loaded) {
+                LogBlock Log;
+                Err.print("kanalyzer", Log.stream());
+                return false;
+            }
+            M = Loaded.get();
+        }
 
-    ModuleList::iterator i, e;
-    for (i = modules.begin(), e = modules.end(); i != e; ++i) {
-        Module *M = i->first;
-        std::string ModuleName = i->second.str();
+        if (!CollectInformation(M, Shards[i]))
+            return false;
+        if (Cache && !Cache->Store(Filename, Shards[i]))
+            LOG_ERROR(LogCollect) << "Error writing fact cache entry for module: " << Filename;
+        return true;
+    };
+
+    if (NumThreads != 1) {
+        ThreadPool Pool(hardware_concurrency(NumThreads));
+        for (size_t i = 0; i < modules.size(); ++i)
+            Pool.async([&Collect, &Collected, i]() { Collected[i] = Collect(i); });
+        Pool.wait();
+    }
+
+    for (size_t i = 0; i < modules.size(); ++i) {
+        std::string ModuleName = modules[i].second.str();
 
-        std::cout << "Processing module: " << ModuleName << std::endl;
+        LOG_INFO(LogCollect) << "Processing module: " << ModuleName;
 
-        if (!CollectInformation(M)) {
-            std::cerr << "Error collecting information for module: " << ModuleName << std::endl;
+        if (NumThreads == 1)
+            Collected[i] = Collect(i);
+
+        if (!Collected[i]) {
+            LOG_ERROR(LogCollect) << "Error collecting information for module: " << ModuleName;
             continue;
         }
+
+        {
+            ScopedTimer Timer("MergeFacts", ModuleName);
+            std::vector<SymbolID> Map;
+            Symbols.Import(*ShardSymbols[i], Map);
+            ShardSymbols[i].reset();
+            Shards[i].RemapSymbols(Map);
+            Facts.Merge(std::move(Shards[i]));
+        }
+
+        PrintModuleFunctionMap(Facts.ModuleFunctionMap, ModuleName);
 	}
 
+    Facts.SortByKey();
+
+    // Dump the merged facts once; dumping them after every module made the
+    // log grow quadratically with the number of modules
+    PrintFunctionPointerSettings(Facts.FunctionPointerSettings);
+    PrintFunctionPointerCallMap(Facts.FunctionPointerCalls);
+
     IdentifyTargets();
 
-    std::cout << "Pass completed: " << ID << std::endl;
+    LOG_INFO(LogCollect) << "Pass completed: " << ID;
 }
 
-bool CallGraphPass::CollectInformation(Module *M) {
+bool CallGraphPass::CollectInformation(Module *M, ModuleFacts &Facts) {
     std::string ModName = M->getName().str();
-    errs() << "Collecting information from module: " << ModName << "\n";
-
-    CollectFunctionProtoTypes(M);
-    CollectStaticFunctionPointerAssignments(M);
-    CollectFunctionPointerArgumentPassing(M);
-    CollectCallingAddressTakenFunction(M);
-    CollectDynamicFunctionPointerAssignments(M);
-    CollectDirectCalls(M);
+    LOG_INFO(LogCollect) << "Collecting information from module: " << ModName;
+
+    ScopedTimer Timer("CollectModule", ModName);
+    uint64_t NumInstructions = 0;
+
+    if (!M->isMaterialized()) {
+        if (!CollectLazyModule(M, Facts, NumInstructions))
+            return false;
+    } else {
+        CollectFunctionProtoTypes(M, Facts);
+        CollectAddressTakenFunctions(M, Facts);
+        CollectGlobalSymbols(M, Facts);
+        CollectStaticFunctionPointerAssignments(M, Facts);
+        CollectInstructionFacts(M, Facts, NumInstructions);
+    }
 
-    PrintModuleFunctionMap(ModuleFunctionMap, M->getName().str());
-    PrintFunctionPointerSettings(FunctionPointerSettings);
-    PrintFunctionPointerCallMap(FunctionPointerCalls);
-    PrintFunctionPointerUseMap(FunctionPointerUses);
+    // Stats outlive the shard's symbol table
+    ModuleStats MS = {Symbols.Intern(ModName), Timer.ElapsedMs(), NumInstructions, 0, 0, 0};
+    MS.Edges = Facts.CallGraph.NumFacts();
+    MS.Settings = Facts.FunctionPointerSettings.NumFacts();
+    MS.FPCalls = Facts.FunctionPointerCalls.NumFacts();
+    Stats.AddModule(MS);
 
     return true;
 }
 
+uint64_t CalledValueHash(SymbolID VarName, SymbolID StructTypeName, unsigned Offset, SymbolID Signature,
+                         ArrayRef<PointerSource> Callee) {
+    hash_code Hash = hash_combine(VarName, StructTypeName, Offset, Signature);
+    for (const PointerSource &Src : Callee)
+        Hash = hash_combine(Hash, (uint8_t)Src.Node.Kind, Src.Node.Scope, Src.Node.Name, Src.Node.Index, Src.Func);
+    return Hash;
+}
+
+CallEdgeKey MakeCallEdgeKey(const CallEdgeInfo &edge, ArrayRef<PointerCallSite> Sites) {
+    if (!edge.IsIndirect)
+        return MakeCallEdgeKey(edge.CallerModule, edge.CallerFunction, edge.Callees.front(), edge.Line);
+
+    // An indirect call recorded without a site has nothing else to tell it apart
+    uint64_t CalledValue = 0;
+    if (edge.PointerSite != NoPointerSite)
+        CalledValue = CalledValueHash(edge.VarName, edge.StructTypeName, edge.Offset, edge.Signature,
+                                      Sites[edge.PointerSite].Callee);
+    return MakeCallEdgeKey(edge.CallerModule, edge.CallerFunction, IndirectSymbol, edge.Line, CalledValue);
+}
+
+void FunctionPointerSettingIndex::Insert(const FunctionPointerSettingInfo &info) {
+    uint64_t Var = PackSymbols(info.ModName, info.VarName);
+
+    ByOffset[{Var, info.Offset}].Insert(info.FuncName);
+    if (info.StructTypeName == EmptySymbol)
+        NonStruct[Var].Insert(info.FuncName);
+}
+
+ArrayRef<SymbolID> FunctionPointerSettingIndex::Find(SymbolID ModName, SymbolID VarName, unsigned Offset) const {
+    auto it = ByOffset.find({PackSymbols(ModName, VarName), Offset});
+    return it == ByOffset.end() ? ArrayRef<SymbolID>() : it->second.targets();
+}
+
+ArrayRef<SymbolID> FunctionPointerSettingIndex::FindNonStruct(SymbolID ModName, SymbolID VarName) const {
+    auto it = NonStruct.find(PackSymbols(ModName, VarName));
+    return it == NonStruct.end() ? ArrayRef<SymbolID>() : it->second.targets();
+}
+
+void ModuleFacts::AddFunctionPointerSetting(uint64_t key, const FunctionPointerSettingInfo &info) {
+    FunctionPointerSettings.Append(key, info);
+    SettingIndex.Insert(info);
+}
+
+void ModuleFacts::Merge(ModuleFacts &&Shard) {
+    for (auto &entry : Shard.ModuleFunctionMap)
+        ModuleFunctionMap[entry.first] = std::move(entry.second);
+
+    for (const auto &group : Shard.FunctionPointerSettings) {
+        for (const auto &info : group)
+            SettingIndex.Insert(info);
+    }
+    FunctionPointerSettings.Merge(std::move(Shard.FunctionPointerSettings));
+
+    ProcessedSettings.insert(Shard.ProcessedSettings.begin(), Shard.ProcessedSettings.end());
+
+    FunctionPointerCalls.Merge(std::move(Shard.FunctionPointerCalls));
+
+    // Call sites are renumbered past the ones merged so far
+    unsigned SiteBase = PointerCallSites.size();
+    for (const auto &entry : Shard.EdgeKeys) {
+        unsigned Site = entry.second;
+        EdgeKeys.try_emplace(entry.first, Site == NoPointerSite ? Site : Site + SiteBase);
+    }
+    for (auto &group : Shard.CallGraph) {
+        for (CallEdgeInfo &edge : group) {
+            if (edge.PointerSite != NoPointerSite)
+                edge.PointerSite += SiteBase;
+        }
+    }
+    CallGraph.Merge(std::move(Shard.CallGraph));
+
+    AddressTakenFunctions.insert(AddressTakenFunctions.end(),
+                                 Shard.AddressTakenFunctions.begin(), Shard.AddressTakenFunctions.end());
+    GlobalSymbols.insert(GlobalSymbols.end(), Shard.GlobalSymbols.begin(), Shard.GlobalSymbols.end());
+    PointerFlows.insert(PointerFlows.end(), Shard.PointerFlows.begin(), Shard.PointerFlows.end());
+    std::move(Shard.PointerCallSites.begin(), Shard.PointerCallSites.end(), std::back_inserter(PointerCallSites));
+
+    Shard = ModuleFacts();
+}
+
+void ModuleFacts::RemapSymbols(ArrayRef<SymbolID> Map) {
+    auto Remap = [Map](SymbolID &ID) { ID = Map[ID]; };
+    auto RemapSource = [&Remap](PointerSource &Src) {
+        Remap(Src.Node.Scope);
+        Remap(Src.Node.Name);
+        Remap(Src.Func);
+    };
+    // Fact table keys keep the module in the high 32 bits
+    auto RemapKey = [Map](uint64_t Key) { return (uint64_t)Map[KeyModule(Key)] << 32 | (uint32_t)Key; };
+
+    SettingIndex = FunctionPointerSettingIndex();
+    FunctionPointerSettings.RemapKeys(RemapKey);
+    for (auto &group : FunctionPointerSettings) {
+        for (auto &info : group) {
+            Remap(info.ModName);
+            Remap(info.VarName);
+            Remap(info.SetterName);
+            Remap(info.StructTypeName);
+            Remap(info.FuncName);
+            SettingIndex.Insert(info);
+        }
+    }
+
+    DenseSet<SettingKey> Settings;
+    for (const SettingKey &key : ProcessedSettings)
+        Settings.insert({PackSymbols(Map[KeyModule(key.first)], Map[(SymbolID)key.first]), key.second});
+    ProcessedSettings = std::move(Settings);
+
+    FunctionPointerCalls.RemapKeys(RemapKey);
+    for (auto &group : FunctionPointerCalls) {
+        for (auto &info : group) {
+            Remap(info.ModName);
+            Remap(info.CallerFuncName);
+            Remap(info.CalleeFuncName);
+        }
+    }
+
+    for (PointerFlow &flow : PointerFlows) {
+        Remap(flow.Dst.Scope);
+        Remap(flow.Dst.Name);
+        RemapSource(flow.Src);
+    }
+    for (PointerCallSite &site : PointerCallSites) {
+        for (PointerSource &Src : site.Callee)
+            RemapSource(Src);
+        for (auto &arg : site.Args)
+            RemapSource(arg.second);
+    }
+
+    // Edge keys hash the symbols of the called value; rebuild them from the
+    // edges once the sites are remapped
+    EdgeKeys.clear();
+    CallGraph.RemapKeys([Map](uint64_t Key) { return (uint64_t)Map[Key]; });
+    for (auto &group : CallGraph) {
+        for (CallEdgeInfo &edge : group) {
+            Remap(edge.CallerModule);
+            Remap(edge.CallerFunction);
+            edge.Callees.Remap(Map);
+            Remap(edge.VarName);
+            Remap(edge.StructTypeName);
+            Remap(edge.Signature);
+            EdgeKeys.try_emplace(MakeCallEdgeKey(edge, PointerCallSites), edge.PointerSite);
+        }
+    }
+
+    for (SymbolID &FuncName : AddressTakenFunctions)
+        Remap(FuncName);
+    for (GlobalSymbolInfo &info : GlobalSymbols) {
+        Remap(info.ModName);
+        Remap(info.Name);
+    }
+}
+
+void ModuleFacts::SortByKey() {
+    FunctionPointerSettings.SortByKey();
+    FunctionPointerCalls.SortByKey();
+    CallGraph.SortByKey();
+}
+
 bool CallGraphPass::IdentifyTargets() {
-    AnalyzeIndirectCalls();
-    ResolveIndirectCalls();
-    AnalyzeStaticFPCallSites();
-    AnalyzeStaticGlobalFPCalls();
+    // Binds references to global variables across modules
+    GlobalSymbolIndex Globals;
+    Globals.Build(Facts.GlobalSymbols);
+
+    // Every edge is recorded by now; resolvers only add targets. Each sound
+    // resolver adds every target it finds, whatever the others found; the
+    // signature match is a guess for calls still without a target.
+    Facts.EdgeKeys = DenseMap<CallEdgeKey, unsigned>();
+    {
+        ScopedTimer Timer("PropagateFunctionPointers");
+        PropagateFunctionPointers(Globals);
+    }
+    {
+        ScopedTimer Timer("AnalyzeGlobalFPCalls");
+        AnalyzeGlobalFPCalls(Globals);
+    }
+    {
+        ScopedTimer Timer("ResolveByStructField");
+        ResolveByStructField();
+    }
+    {
+        ScopedTimer Timer("ResolveBySignature");
+        ResolveBySignature();
+    }
 
-    PrintCallGraph(CallGraph);
+    if (DumpCallGraph)
+        PrintCallGraph(Facts.CallGraph);
+
+    FinalizeCallGraph();
 
     return true;
 }
 
+void CallGraphPass::FinalizeCallGraph() {
+    ScopedTimer Timer("FinalizeCallGraph");
+    std::vector<CompactEdge> Edges;
+    unsigned Unresolved = 0;
 
-void CallGraphPass::CollectFunctionProtoTypes(Module *M) {
-    std::string ModName = M->getName().str();  // Get the module name
-    std::map<std::string, std::vector<std::tuple<std::string, std::vector<std::string>, std::string>>> FuncProtoTypes;
+    for (const auto &group : Facts.CallGraph) {
+        for (const auto &edge : group) {
+            // Indirect calls no resolver could attribute have no callee node
+            if (edge.Callees.empty()) {
+                ++Unresolved;
+                continue;
+            }
+            if (edge.IsIndirect)
+                Stats.Add(StatIndirectResolved);
 
-    // Iterate over all functions in the module
-    for (Function &F : M->functions()) {
-        // Skip function declarations (functions without a body)
-        if (F.isDeclaration()) continue;
-
-        // Get the function name
-        std::string FuncName = F.getName().str();
-        std::vector<std::string> ArgTypes;
-        
-        // Get the return type
-        std::string ReturnType;
-        llvm::raw_string_ostream ReturnTypeStream(ReturnType);  // Use raw_string_ostream properly
-        F.getReturnType()->print(ReturnTypeStream);  // Print return type to the stream
-
-        // Get the argument types
-        for (unsigned i = 0; i < F.arg_size(); ++i) {
-            std::string ArgType;
-            llvm::raw_string_ostream ArgTypeStream(ArgType);  // Create a stream for each argument type
-            F.getFunctionType()->getParamType(i)->print(ArgTypeStream);  // Print argument type to the stream
-            ArgTypes.push_back(ArgType);
+            // One graph edge per target
+            uint8_t Flags = (edge.IsIndirect ? EdgeIndirect : 0) | (edge.TypeMatched ? EdgeTypeMatched : 0);
+            for (SymbolID Callee : edge.Callees)
+                Edges.push_back({edge.CallerFunction, Callee, edge.Line, Flags});
         }
+    }
 
-        // Get the line number in the source code
-        unsigned Line = 0;
-        if (DISubprogram *SP = F.getSubprogram()) {
-            Line = SP->getLine();
-        }
+    Graph.Build(Edges);
+
+    Stats.Add(StatIndirectUnresolved, Unresolved);
+    Stats.Add(StatGraphFunctions, Graph.NumFunctions());
+    Stats.Add(StatGraphEdges, Graph.NumEdges());
+
+    LOG_INFO(LogGraph) << "Compact call graph: " << Graph.NumFunctions() << " functions, "
+           << Graph.NumEdges() << " edges (" << Unresolved << " unresolved indirect calls skipped), "
+           << Graph.MemoryUsage() << " bytes";
+}
 
-        // Add the function prototype to the module's map
-        FuncProtoTypes[FuncName].push_back(std::make_tuple(ReturnType, ArgTypes, std::to_string(Line)));
+
+// Print the return and parameter types of FTy the way ModuleFunctionMap stores them
+static void PrintFunctionType(FunctionType *FTy, std::string &ReturnType, std::vector<std::string> &ArgTypes) {
+    llvm::raw_string_ostream ReturnTypeStream(ReturnType);  // Use raw_string_ostream properly
+    FTy->getReturnType()->print(ReturnTypeStream);  // Print return type to the stream
+    ReturnTypeStream.flush();
+
+    for (Type *ParamType : FTy->params()) {
+        std::string ArgType;
+        llvm::raw_string_ostream ArgTypeStream(ArgType);  // Create a stream for each argument type
+        ParamType->print(ArgTypeStream);  // Print argument type to the stream
+        ArgTypes.push_back(ArgTypeStream.str());
     }
+}
 
+void CallGraphPass::CollectFunctionProtoTypes(Module *M, ModuleFacts &Facts) {
     // Store the function prototypes under the module name
-    ModuleFunctionMap[ModName] = std::move(FuncProtoTypes);
+    FunctionProtoTypeMap &FuncProtoTypes = Facts.ModuleFunctionMap[M->getName().str()];
+
+    // Iterate over all functions in the module
+    for (Function &F : M->functions())
+        CollectFunctionProtoType(F, FuncProtoTypes);
 }
 
-void CallGraphPass::CollectStaticFunctionPointerAssignments(Module *M) {
-    std::string ModName = M->getName().str();
+void CallGraphPass::CollectFunctionProtoType(Function &F, FunctionProtoTypeMap &FuncProtoTypes) {
+    // Skip function declarations (functions without a body)
+    if (F.isDeclaration()) return;
+
+    // Get the function name
+    std::string FuncName = F.getName().str();
+
+    // Get the return and argument types
+    std::string ReturnType;
+    std::vector<std::string> ArgTypes;
+    PrintFunctionType(F.getFunctionType(), ReturnType, ArgTypes);
+
+    // Get the line number in the source code
+    unsigned Line = 0;
+    if (DISubprogram *SP = F.getSubprogram()) {
+        Line = SP->getLine();
+    }
+
+    // Add the function prototype to the module's map
+    FuncProtoTypes[FuncName].push_back(std::make_tuple(ReturnType, ArgTypes, std::to_string(Line)));
+}
+
+void CallGraphPass::CollectAddressTakenFunctions(Module *M, ModuleFacts &Facts) {
+    for (Function &F : M->functions()) {
+        // References from llvm.used do not make a function callable through a pointer
+        if (!F.isIntrinsic() && F.hasAddressTaken(nullptr, false, true, /*IgnoreLLVMUsed=*/true))
+            Facts.AddressTakenFunctions.push_back(Intern(F.getName()));
+    }
+}
+
+void CallGraphPass::CollectGlobalSymbols(Module *M, ModuleFacts &Facts) {
+    SymbolID ModName = Intern(M->getName());
+
+    for (GlobalVariable &GV : M->globals()) {
+        if (!GV.hasName())
+            continue;
+
+        bool Defined = !GV.isDeclaration();
+        Facts.GlobalSymbols.push_back({ModName, Intern(GV.getName()), Defined, GV.hasLocalLinkage(),
+                                       Defined && GV.isWeakForLinker()});
+    }
+}
+
+void CallGraphPass::CollectStaticFunctionPointerAssignments(Module *M, ModuleFacts &Facts) {
+    SymbolID ModName = Intern(M->getName());
 
     for (GlobalVariable &GV : M->globals()) {
         // Skip if the global has no initializer
@@ -123,64 +472,119 @@ void CallGraphPass::CollectStaticFunctionPointerAssignments(Module *M) {
             const StructType *ST = dyn_cast<StructType>(GV.getValueType());
             if (!ST) continue;
 
-            std::string StructTypeName;
+            SymbolID StructTypeName = EmptySymbol;
             if (ST->hasName())
-                StructTypeName = ST->getName().str();
+                StructTypeName = Intern(ST->getName());
 
             for (unsigned i = 0; i < CS->getNumOperands(); ++i) {
                 Value *op = CS->getOperand(i);
 
+                // Structs and arrays of structs embedded in the struct
+                if (isa<ConstantStruct>(op) || isa<ConstantArray>(op)) {
+                    CollectNestedStructInitializers(cast<Constant>(op), ModName, Facts);
+                    continue;
+                }
+
                 if (Function *F = dyn_cast<Function>(op)) {
                     // Record function pointer assignment from struct initializer
                     FunctionPointerSettingInfo settingInfo;
                     settingInfo.ModName = ModName;
-                    settingInfo.VarName = GV.getName().str();  // Variable name from global
-                    settingInfo.SetterName = "global";
+                    settingInfo.VarName = Intern(GV.getName());  // Variable name from global
+                    settingInfo.SetterName = GlobalSymbol;
                     settingInfo.StructTypeName = StructTypeName;
-                    settingInfo.FuncName = F->getName().str();
+                    settingInfo.FuncName = Intern(F->getName());
                     settingInfo.Line = 0;  // No line info for static globals
                     settingInfo.Offset = i;
 
-                    std::string key = ModName + ":0";  // Use line 0 as placeholder
-                    FunctionPointerSettings[key].push_back(settingInfo);
+                    uint64_t key = MakeLineKey(ModName, 0);  // Use line 0 as placeholder
+                    Facts.AddFunctionPointerSetting(key, settingInfo);
                 }
             }
         }
 
-        // Case 2: Global variable directly initialized with a function
+        // Case 2: Global is an array of structs (e.g., a table of operations)
+        if (isa<ConstantArray>(Init))
+            CollectNestedStructInitializers(Init, ModName, Facts);
+
+        // Case 3: Global variable directly initialized with a function
         if (Function *F = dyn_cast<Function>(Init)) {
             FunctionPointerSettingInfo settingInfo;
             settingInfo.ModName = ModName;
-            settingInfo.VarName = GV.getName().str();  // Variable name
-            settingInfo.SetterName = "global";
-            settingInfo.StructTypeName = "";  // Not part of a struct
-            settingInfo.FuncName = F->getName().str();
+            settingInfo.VarName = Intern(GV.getName());  // Variable name
+            settingInfo.SetterName = GlobalSymbol;
+            settingInfo.StructTypeName = EmptySymbol;  // Not part of a struct
+            settingInfo.FuncName = Intern(F->getName());
             settingInfo.Line = 0;
             settingInfo.Offset = 0;
 
-            std::string key = ModName + ":0";
-            FunctionPointerSettings[key].push_back(settingInfo);
+            uint64_t key = MakeLineKey(ModName, 0);
+            Facts.AddFunctionPointerSetting(key, settingInfo);
+        }
+    }
+}
+
+// Record the functions in the fields of a struct nested in a global's
+// initializer. They are not reachable through the global's name, so only
+// their struct type and field are recorded, for ResolveByStructField().
+void CallGraphPass::CollectNestedStructInitializers(Constant *Init, SymbolID ModName, ModuleFacts &Facts) {
+    if (auto *CA = dyn_cast<ConstantArray>(Init)) {
+        for (unsigned i = 0; i < CA->getNumOperands(); ++i)
+            CollectNestedStructInitializers(CA->getOperand(i), ModName, Facts);
+        return;
+    }
+
+    auto *CS = dyn_cast<ConstantStruct>(Init);
+    if (!CS)
+        return;
+
+    StructType *ST = CS->getType();
+    SymbolID StructTypeName = ST->hasName() ? Intern(ST->getName()) : EmptySymbol;
+
+    for (unsigned i = 0; i < CS->getNumOperands(); ++i) {
+        Constant *op = CS->getOperand(i);
+
+        if (isa<ConstantStruct>(op) || isa<ConstantArray>(op)) {
+            CollectNestedStructInitializers(op, ModName, Facts);
+            continue;
         }
+
+        Function *F = dyn_cast<Function>(op->stripPointerCasts());
+        if (!F || StructTypeName == EmptySymbol)
+            continue;
+
+        FunctionPointerSettingInfo settingInfo;
+        settingInfo.ModName = ModName;
+        settingInfo.VarName = EmptySymbol;
+        settingInfo.SetterName = GlobalSymbol;
+        settingInfo.StructTypeName = StructTypeName;
+        settingInfo.FuncName = Intern(F->getName());
+        settingInfo.Line = 0;
+        settingInfo.Offset = i;
+
+        Facts.AddFunctionPointerSetting(MakeLineKey(ModName, 0), settingInfo);
     }
 }
 
 
 void CallGraphPass::RecordFunctionPointerSetting(
-    const std::string &ModName,
-    const std::string &SetterName,
-    const std::string &StructTypeName,
-    const std::string &FuncName,
+    ModuleFacts &Facts,
+    SymbolID ModName,
+    SymbolID SetterName,
+    SymbolID StructTypeName,
+    SymbolID FuncName,
     unsigned Line,
     unsigned Offset) {
 
     // Check if the function pointer has already been recorded for this module and line
-    if (ProcessedSettings.find({ModName, FuncName, Line, Offset}) != ProcessedSettings.end()) {
+    SettingKey key{PackSymbols(ModName, FuncName), PackSymbols(Line, Offset)};
+    if (!Facts.ProcessedSettings.insert(key).second) {
         return;  // Skip if already processed
     }
 
     // Record the setting
     FunctionPointerSettingInfo settingInfo;
     settingInfo.ModName = ModName;
+    settingInfo.VarName = EmptySymbol;
     settingInfo.SetterName = SetterName;
     settingInfo.StructTypeName = StructTypeName;
     settingInfo.FuncName = FuncName;
@@ -188,362 +592,598 @@ void CallGraphPass::RecordFunctionPointerSetting(
     settingInfo.Offset = Offset;
 
     // Insert the setting info into the appropriate map, grouped by module name and line
-    FunctionPointerSettings[ModName + ":" + std::to_string(Line)].push_back(settingInfo);
-
-    // Add the setting to the processed set to avoid future duplication
-    ProcessedSettings.insert({ModName, FuncName, Line, Offset});
+    Facts.AddFunctionPointerSetting(MakeLineKey(ModName, Line), settingInfo);
 
     // Log the addition of the function pointer setting
-    errs() << "[debug] Found function pointer setting: " << SetterName
-           << " in module " << ModName << " at line " << Line
-           << " for function " << FuncName << " with offset " << Offset << "\n";
+    LOG_DEBUG(LogCollect) << "Found function pointer setting: " << SymbolName(SetterName)
+           << " in module " << SymbolName(ModName) << " at line " << Line
+           << " for function " << SymbolName(FuncName) << " with offset " << Offset;
 }
 
-void CallGraphPass::CollectCallingAddressTakenFunction(Module *M) {
-    std::string ModName = M->getName().str();
+// InstructionFactVisitor: Walks every instruction of a module once and hands
+// each call and store to the collectors interested in it. The called operand
+// and debug line of a call are resolved here, once, for all collectors.
+class CallGraphPass::InstructionFactVisitor
+    : public InstVisitor<CallGraphPass::InstructionFactVisitor> {
+    CallGraphPass &Pass;
+    ModuleFacts &Facts;
+    // Direct call edges are appended after the indirect ones, in the same
+    // order the separate per-collector walks used to produce them.
+    ModuleFacts DirectCallFacts;
+    InstructionContext Ctx;
+
+public:
+    InstructionFactVisitor(CallGraphPass &Pass, ModuleFacts &Facts, SymbolID ModName)
+        : Pass(Pass), Facts(Facts), Ctx(ModName) { }
+
+    uint64_t NumInstructions = 0;
+
+    // Count every instruction on its way to the visit* handlers
+    using InstVisitor::visit;
+    void visit(Instruction &I) {
+        ++NumInstructions;
+        InstVisitor::visit(I);
+    }
 
-    for (Function &F : *M) {
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                if (auto *call = dyn_cast<CallInst>(&I)) {
-                    Value *calledValue = call->getCalledOperand()->stripPointerCasts();
-
-                    // Skip direct function calls
-                    if (isa<Function>(calledValue)) continue;
-
-                    std::string varName = "";
-                    unsigned offset = 0;
-
-                    // Try to extract variable name and offset used in the indirect call
-                    if (auto *load = dyn_cast<LoadInst>(calledValue)) {
-                        Value *ptr = load->getPointerOperand();
-
-                        // Local variable case (alloca)
-                        if (auto *alloca = dyn_cast<AllocaInst>(ptr)) {
-                            varName = alloca->getName().str();
-                        }
-                        // Global variable case
-                        else if (auto *global = dyn_cast<GlobalVariable>(ptr)) {
-                            varName = global->getName().str();
-                        }
-                    }
-
-                    // For direct global loads like @sfp
-                    if (auto *global = dyn_cast<GlobalVariable>(calledValue)) {
-                        varName = global->getName().str();
-                    }
-
-                    // Set offset if dealing with struct (e.g., .foo, .bar)
-                    if (auto *gep = dyn_cast<GetElementPtrInst>(calledValue)) {
-                        offset = 0; // You can refine the logic to get the specific offset for each field
-                    }
-
-                    unsigned line = getLineNumber(call);
-                    RecordCallGraphEdge(ModName, F.getName().str(), "indirect", line, true, varName, offset);
-
-                    errs() << "[debug] Recorded indirect call: " << F.getName()
-                           << " -> indirect (line: " << line << ")"
-                           << " via variable: " << varName << " with offset: " << offset << " in module: " << ModName << "\n";
-                }
-            }
+    void visitFunction(Function &F) {
+        Ctx.FuncName = Intern(F.getName());
+        Ctx.Locals.clear();
+    }
+
+    void visitStoreInst(StoreInst &SI) {
+        Pass.CollectDynamicFunctionPointerAssignments(SI, Ctx, Facts);
+        Pass.CollectPointerFlows(SI, Ctx, Facts);
+    }
+
+    void visitReturnInst(ReturnInst &RI) {
+        Pass.CollectPointerFlows(RI, Ctx, Facts);
+    }
+
+    void visitCallBase(CallBase &CB) {
+        Value *calledValue = CB.getCalledOperand()->stripPointerCasts();
+        Ctx.Line = Pass.getLineNumber(&CB);
+
+        if (Function *calledFunc = dyn_cast<Function>(calledValue)) {
+            Pass.CollectFunctionPointerArgumentPassing(CB, Ctx, Facts);
+            Pass.CollectPointerFlows(CB, Ctx, Facts);
+            Pass.CollectDirectCalls(calledFunc, Ctx, DirectCallFacts);
+        } else if (auto *call = dyn_cast<CallInst>(&CB)) {
+            Pass.CollectCallingAddressTakenFunction(*call, calledValue, Ctx, Facts);
         }
     }
+
+    void finish() {
+        Facts.Merge(std::move(DirectCallFacts));
+    }
+};
+
+void CallGraphPass::CollectInstructionFacts(Module *M, ModuleFacts &Facts, uint64_t &NumInstructions) {
+    InstructionFactVisitor Visitor(*this, Facts, Intern(M->getName()));
+    Visitor.visit(*M);
+    Visitor.finish();
+    NumInstructions = Visitor.NumInstructions;
 }
 
-void CallGraphPass::CollectDynamicFunctionPointerAssignments(Module *M) {
-    std::string ModName = M->getName().str();
+bool CallGraphPass::CollectLazyModule(Module *M, ModuleFacts &Facts, uint64_t &NumInstructions) {
+    // Global initializers are read with the module; only bodies are lazy.
+    // No body is resident yet, so this sees the uses from globals only.
+    CollectAddressTakenFunctions(M, Facts);
+    CollectGlobalSymbols(M, Facts);
+    CollectStaticFunctionPointerAssignments(M, Facts);
+    DenseSet<const Function *> AddressTaken;
 
-    for (Function &F : *M) {
-        if (F.isDeclaration()) continue;
-
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                if (auto *store = dyn_cast<StoreInst>(&I)) {
-                    Value *val = store->getValueOperand()->stripPointerCasts();
-                    if (Function *Fptr = dyn_cast<Function>(val)) {
-                        unsigned Line = 0;
-                        if (DILocation *Loc = I.getDebugLoc())
-                            Line = Loc->getLine();
-
-                        std::string Setter = F.getName().str();
-                        RecordFunctionPointerSetting(ModName, Setter, "", Fptr->getName().str(), Line, 0);
-                    }
-                }
+    FunctionProtoTypeMap &FuncProtoTypes = Facts.ModuleFunctionMap[M->getName().str()];
+    InstructionFactVisitor Visitor(*this, Facts, Intern(M->getName()));
+
+    // Materialize each body, collect everything that needs it and drop it
+    // again, so at most one function body is resident at a time
+    for (Function &F : M->functions()) {
+        if (F.isMaterializable()) {
+            if (Error E = F.materialize()) {
+                LOG_ERROR(LogCollect) << "Error materializing function " << F.getName() << ": "
+                                      << toString(std::move(E));
+                return false;
+            }
+        }
+
+        CollectFunctionProtoType(F, FuncProtoTypes);
+        Visitor.visit(F);
+
+        // The uses in this body disappear with it; note the functions it
+        // refers to other than by calling them
+        for (Instruction &I : instructions(F)) {
+            auto *CB = dyn_cast<CallBase>(&I);
+            for (Use &U : I.operands()) {
+                auto *G = dyn_cast<Function>(U->stripPointerCasts());
+                if (!G || G->isIntrinsic() || (CB && CB->isCallee(&U)))
+                    continue;
+                if (AddressTaken.insert(G).second)
+                    Facts.AddressTakenFunctions.push_back(Intern(G->getName()));
             }
         }
+
+        if (!F.isDeclaration())
+            F.deleteBody();
     }
+
+    Visitor.finish();
+    NumInstructions = Visitor.NumInstructions;
+    return true;
 }
 
-void CallGraphPass::CollectFunctionPointerArgumentPassing(Module *M) {
-    std::string ModName = M->getName().str();
+// A pointer to a struct, cast to the type of its leading member, points to
+// that member. Returns the innermost struct of T whose first field has
+// FieldType, or nullptr.
+static StructType *LeadingFieldStruct(Type *T, Type *FieldType) {
+    while (auto *ST = dyn_cast_or_null<StructType>(T)) {
+        if (ST->getNumElements() == 0)
+            return nullptr;
+        if (ST->getElementType(0) == FieldType)
+            return ST;
+        T = ST->getElementType(0);
+    }
+    return nullptr;
+}
 
-    for (Function &F : *M) {
-        if (F.isDeclaration()) continue;
-
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                if (auto *call = dyn_cast<CallBase>(&I)) {
-                    Function *calledFunc = dyn_cast<Function>(call->getCalledOperand()->stripPointerCasts());
-                    if (!calledFunc) continue;
-
-                    for (unsigned i = 0; i < call->arg_size(); ++i) {
-                        Value *arg = call->getArgOperand(i)->stripPointerCasts();
-                        if (Function *passedFunc = dyn_cast<Function>(arg)) {
-                            unsigned Line = 0;
-                            if (DILocation *Loc = I.getDebugLoc())
-                                Line = Loc->getLine();
-
-                            std::string Caller = F.getName().str();
-                            std::string Callee = passedFunc->getName().str();
-
-                            // Record the function pointer call via argument
-                            RecordFunctionPointerCall(ModName, Caller, Callee, Line, i);
-                        }
-                    }
-                }
+// Find the struct field Ptr points to, for a load or store of ValueType:
+// the innermost named struct indexed by a GEP (instruction or constant
+// expression), or the leading field of a struct cast to a pointer to it.
+// Literal (unnamed) structs have no name to match across modules and are
+// not reported.
+static bool GetStructField(Value *Ptr, Type *ValueType, SymbolID &StructTypeName, unsigned &Field) {
+    // Look through casts only; stripPointerCasts() also drops the all-zero
+    // GEPs that select the first field
+    while (auto *Op = dyn_cast<Operator>(Ptr)) {
+        if (Op->getOpcode() != Instruction::BitCast && Op->getOpcode() != Instruction::AddrSpaceCast)
+            break;
+        Ptr = Op->getOperand(0);
+    }
+
+    StructType *Found = nullptr;
+    unsigned FoundField = 0;
+    Type *Pointee = nullptr;
+
+    if (auto *GEP = dyn_cast<GEPOperator>(Ptr)) {
+        for (gep_type_iterator GTI = gep_type_begin(GEP), E = gep_type_end(GEP); GTI != E; ++GTI) {
+            // Struct indices are always constants
+            if (StructType *ST = GTI.getStructTypeOrNull()) {
+                Found = ST;
+                FoundField = cast<ConstantInt>(GTI.getOperand())->getZExtValue();
             }
         }
+        Pointee = GEP->getResultElementType();
+    } else if (!Ptr->getType()->isOpaquePointerTy()) {
+        Pointee = Ptr->getType()->getNonOpaquePointerElementType();
     }
+
+    if (Pointee != ValueType) {
+        if (StructType *ST = LeadingFieldStruct(Pointee, ValueType)) {
+            Found = ST;
+            FoundField = 0;
+        }
+    }
+
+    if (!Found || !Found->hasName())
+        return false;
+
+    StructTypeName = Intern(Found->getName());
+    Field = FoundField;
+    return true;
 }
 
-void CallGraphPass::CollectDirectCalls(Module *M) {
-    std::string ModName = M->getName().str();
+// Values of function pointer type, or function addresses cast to another type
+static bool MayHoldFunctionPointer(Value *V) {
+    if (isa<Function>(V->stripPointerCasts()))
+        return true;
+
+    Type *T = V->getType();
+    return T->isPointerTy() && !T->isOpaquePointerTy() && T->getNonOpaquePointerElementType()->isFunctionTy();
+}
+
+// Map the memory a load or store of ValueType accesses to a PointerNode:
+// a struct field, a stack variable or a global variable. Anything else, such
+// as memory reached through a loaded pointer, is not tracked.
+bool CallGraphPass::GetPointerNode(Value *Ptr, Type *ValueType, InstructionContext &Ctx, PointerNode &Node) {
+    SymbolID StructTypeName = EmptySymbol;
+    unsigned Field = 0;
+    if (GetStructField(Ptr, ValueType, StructTypeName, Field)) {
+        Node = {PointerNodeKind::Field, StructTypeName, EmptySymbol, Field};
+        return true;
+    }
 
-    for (Function &F : *M) {
-        if (F.isDeclaration()) continue;
+    Value *Base = Ptr->stripPointerCasts();
+    if (auto *AI = dyn_cast<AllocaInst>(Base)) {
+        unsigned Local = Ctx.Locals.try_emplace(AI, Ctx.Locals.size()).first->second;
+        Node = {PointerNodeKind::Local, Ctx.FuncName, Ctx.ModName, Local};
+        return true;
+    }
+    if (auto *GV = dyn_cast<GlobalVariable>(Base)) {
+        Node = {PointerNodeKind::Global, Ctx.ModName, Intern(GV->getName()), 0};
+        return true;
+    }
+    return false;
+}
+
+// Collect where V may come from: function addresses, formal arguments, the
+// return values of direct calls and the nodes loads read from. PHIs and
+// selects contribute the sources of all their operands.
+void CallGraphPass::CollectPointerSources(
+    Value *V, InstructionContext &Ctx, std::vector<PointerSource> &Sources) {
 
-        std::string CallerFunc = F.getName().str();
+    SmallVector<Value *, 4> Worklist{V};
+    SmallPtrSet<Value *, 8> Visited;
 
-        for (BasicBlock &BB : F) {
-            for (Instruction &I : BB) {
-                // Look for direct call instructions
-                if (auto *call = dyn_cast<CallBase>(&I)) {
-                    // Resolve the callee function
-                    Function *calleeFunc = dyn_cast<Function>(call->getCalledOperand()->stripPointerCasts());
+    while (!Worklist.empty()) {
+        Value *Cur = Worklist.pop_back_val()->stripPointerCasts();
+        if (!Visited.insert(Cur).second)
+            continue;
+
+        PointerNode Node;
+        if (auto *F = dyn_cast<Function>(Cur)) {
+            if (!F->isIntrinsic())
+                Sources.push_back({{}, Intern(F->getName())});
+        } else if (auto *A = dyn_cast<Argument>(Cur)) {
+            Sources.push_back({{PointerNodeKind::Argument, Ctx.FuncName, EmptySymbol, A->getArgNo()}, EmptySymbol});
+        } else if (auto *load = dyn_cast<LoadInst>(Cur)) {
+            if (GetPointerNode(load->getPointerOperand(), load->getType(), Ctx, Node))
+                Sources.push_back({Node, EmptySymbol});
+        } else if (auto *CB = dyn_cast<CallBase>(Cur)) {
+            if (Function *Callee = CB->getCalledFunction())
+                Sources.push_back({{PointerNodeKind::Return, Intern(Callee->getName()), EmptySymbol, 0}, EmptySymbol});
+        } else if (auto *PN = dyn_cast<PHINode>(Cur)) {
+            Worklist.append(PN->op_begin(), PN->op_end());
+        } else if (auto *SI = dyn_cast<SelectInst>(Cur)) {
+            Worklist.push_back(SI->getTrueValue());
+            Worklist.push_back(SI->getFalseValue());
+        }
+    }
+}
 
-                    // Skip if we can't resolve the callee at all (e.g., function pointer)
-                    if (!calleeFunc) continue;
+// Record the function pointer flows of a store, a return or a direct call:
+// into the stored-to memory, into the function's return value, and from
+// the call's arguments into the callee's formals. Indirect calls keep their
+// arguments in their PointerCallSite instead.
+void CallGraphPass::CollectPointerFlows(Instruction &I, InstructionContext &Ctx, ModuleFacts &Facts) {
+    std::vector<PointerSource> Sources;
+    PointerNode Dst;
+
+    auto AddFlows = [&](Value *V, const PointerNode &Dst) {
+        Sources.clear();
+        CollectPointerSources(V, Ctx, Sources);
+        for (const PointerSource &Src : Sources)
+            Facts.PointerFlows.push_back({Dst, Src});
+    };
+
+    if (auto *SI = dyn_cast<StoreInst>(&I)) {
+        Value *V = SI->getValueOperand();
+        if (MayHoldFunctionPointer(V) && GetPointerNode(SI->getPointerOperand(), V->getType(), Ctx, Dst))
+            AddFlows(V, Dst);
+    } else if (auto *RI = dyn_cast<ReturnInst>(&I)) {
+        Value *V = RI->getReturnValue();
+        if (V && MayHoldFunctionPointer(V))
+            AddFlows(V, {PointerNodeKind::Return, Ctx.FuncName, EmptySymbol, 0});
+    } else if (auto *CB = dyn_cast<CallBase>(&I)) {
+        Function *Callee = dyn_cast<Function>(CB->getCalledOperand()->stripPointerCasts());
+        if (!Callee || Callee->isIntrinsic())
+            return;
+
+        SymbolID CalleeName = Intern(Callee->getName());
+        for (unsigned i = 0; i < CB->arg_size(); ++i) {
+            Value *arg = CB->getArgOperand(i);
+            if (MayHoldFunctionPointer(arg))
+                AddFlows(arg, {PointerNodeKind::Argument, CalleeName, EmptySymbol, i});
+        }
+    }
+}
 
-                    std::string CalleeFunc = calleeFunc->getName().str();
-                    unsigned Line = 0;
-                    if (DILocation *Loc = I.getDebugLoc())
-                        Line = Loc->getLine();
+void CallGraphPass::CollectCallingAddressTakenFunction(
+    CallInst &call, Value *calledValue, InstructionContext &Ctx, ModuleFacts &Facts) {
 
-                    // Record all resolved direct calls, including external functions like printf
-                    RecordCallGraphEdge(ModName, CallerFunc, CalleeFunc, Line, false);
-                }
-            }
+    SymbolID varName = EmptySymbol;
+    unsigned offset = 0;
+
+    // Try to extract variable name and offset used in the indirect call
+    if (auto *load = dyn_cast<LoadInst>(calledValue)) {
+        Value *ptr = load->getPointerOperand();
+
+        // Local variable case (alloca)
+        if (auto *alloca = dyn_cast<AllocaInst>(ptr)) {
+            varName = Intern(alloca->getName());
         }
+        // Global variable case
+        else if (auto *global = dyn_cast<GlobalVariable>(ptr)) {
+            varName = Intern(global->getName());
+        }
+    }
+
+    // For direct global loads like @sfp
+    if (auto *global = dyn_cast<GlobalVariable>(calledValue)) {
+        varName = Intern(global->getName());
+    }
+
+    // Struct field the pointer is loaded from (e.g., .foo, .bar)
+    SymbolID structTypeName = EmptySymbol;
+    if (auto *load = dyn_cast<LoadInst>(calledValue))
+        GetStructField(load->getPointerOperand(), load->getType(), structTypeName, offset);
+
+    std::string ReturnType;
+    std::vector<std::string> ArgTypes;
+    PrintFunctionType(call.getFunctionType(), ReturnType, ArgTypes);
+    SymbolID signature = Intern(FunctionSignature(ReturnType, ArgTypes));
+
+    // Where the called pointer and the function pointers passed along come from
+    PointerCallSite Site;
+    CollectPointerSources(calledValue, Ctx, Site.Callee);
+    for (unsigned i = 0; i < call.arg_size(); ++i) {
+        Value *arg = call.getArgOperand(i);
+        if (!MayHoldFunctionPointer(arg))
+            continue;
+
+        std::vector<PointerSource> Sources;
+        CollectPointerSources(arg, Ctx, Sources);
+        for (const PointerSource &Src : Sources)
+            Site.Args.push_back({i, Src});
+    }
+
+    // The same call repeated on this line, e.g. by a macro, shares the edge.
+    // Its called pointer comes from the same place, so only its arguments
+    // are added to that edge's site. Other indirect calls on the line get
+    // edges and sites of their own.
+    uint64_t CalledValue = CalledValueHash(varName, structTypeName, offset, signature, Site.Callee);
+    auto existing = Facts.EdgeKeys.find(
+        MakeCallEdgeKey(Ctx.ModName, Ctx.FuncName, IndirectSymbol, Ctx.Line, CalledValue));
+    if (existing != Facts.EdgeKeys.end()) {
+        Stats.Add(StatEdgesDeduplicated);
+        if (existing->second == NoPointerSite)
+            return;
+
+        PointerCallSite &Shared = Facts.PointerCallSites[existing->second];
+        Shared.Args.insert(Shared.Args.end(), Site.Args.begin(), Site.Args.end());
+
+        LOG_DEBUG(LogCollect) << "Merged indirect call: " << SymbolName(Ctx.FuncName)
+               << " -> indirect (line: " << Ctx.Line << ") in module: " << SymbolName(Ctx.ModName);
+        return;
     }
+
+    unsigned site = Facts.PointerCallSites.size();
+    Facts.PointerCallSites.push_back(std::move(Site));
+
+    RecordCallGraphEdge(Facts, Ctx.ModName, Ctx.FuncName, IndirectSymbol, Ctx.Line, true, varName, offset, signature,
+                        structTypeName, site);
+
+    LOG_DEBUG(LogCollect) << "Recorded indirect call: " << SymbolName(Ctx.FuncName)
+           << " -> indirect (line: " << Ctx.Line << ")"
+           << " via variable: " << SymbolName(varName) << " with offset: " << offset
+           << " in struct: " << SymbolName(structTypeName)
+           << " in module: " << SymbolName(Ctx.ModName);
 }
 
+void CallGraphPass::CollectDynamicFunctionPointerAssignments(
+    StoreInst &store, const InstructionContext &Ctx, ModuleFacts &Facts) {
 
-void CallGraphPass::AnalyzeIndirectCalls() {
-    for (const auto &entry : FunctionPointerUses) {
-        const std::string &key = entry.first;
-        const std::vector<FunctionPointerUseInfo> &uses = entry.second;
+    Value *val = store.getValueOperand()->stripPointerCasts();
+    if (Function *Fptr = dyn_cast<Function>(val)) {
+        unsigned Line = getLineNumber(&store);
 
-        for (const auto &use : uses) {
-            // Create a call edge with "indirect" as the callee function
-            RecordCallGraphEdge(
-                use.ModName,
-                use.CallerFuncName,
-                "indirect",  // Placeholder
-                use.Line,
-                true         // IsIndirect
-            );
+        // Stores to a struct field (e.g., ops->foo = myfoo) are keyed on the field
+        SymbolID StructTypeName = EmptySymbol;
+        unsigned Offset = 0;
+        GetStructField(store.getPointerOperand(), store.getValueOperand()->getType(), StructTypeName, Offset);
+
+        RecordFunctionPointerSetting(Facts, Ctx.ModName, Ctx.FuncName, StructTypeName, Intern(Fptr->getName()),
+                                     Line, Offset);
+    }
+}
+
+void CallGraphPass::CollectFunctionPointerArgumentPassing(
+    CallBase &call, const InstructionContext &Ctx, ModuleFacts &Facts) {
+
+    for (unsigned i = 0; i < call.arg_size(); ++i) {
+        Value *arg = call.getArgOperand(i)->stripPointerCasts();
+        if (Function *passedFunc = dyn_cast<Function>(arg)) {
+            // Record the function pointer call via argument
+            RecordFunctionPointerCall(Facts, Ctx.ModName, Ctx.FuncName, Intern(passedFunc->getName()), Ctx.Line, i);
         }
     }
 }
 
-void CallGraphPass::ResolveIndirectCalls() {
-    for (auto &modEntry : CallGraph) {
-        std::string ModName = modEntry.first;
-        std::vector<CallEdgeInfo> &edges = modEntry.second;
+void CallGraphPass::CollectDirectCalls(
+    Function *calleeFunc, const InstructionContext &Ctx, ModuleFacts &Facts) {
+
+    // Record all resolved direct calls, including external functions like printf
+    RecordCallGraphEdge(Facts, Ctx.ModName, Ctx.FuncName, Intern(calleeFunc->getName()), Ctx.Line, false);
+}
+
+
+void CallGraphPass::PropagateFunctionPointers(const GlobalSymbolIndex &Globals) {
+    PointerFlowSolver Solver;
+    Solver.Solve(Facts, Globals);
 
-        for (auto &edge : edges) {
-            // Only process unresolved indirect calls
-            if (!edge.IsIndirect || edge.CalleeFunction != "indirect")
+    LOG_INFO(LogResolve) << "Propagated function pointers over " << Solver.NumNodes()
+                         << " nodes in " << Solver.NumSteps() << " steps";
+
+    for (auto &group : Facts.CallGraph) {
+        for (auto &edge : group) {
+            if (!edge.IsIndirect || edge.PointerSite == NoPointerSite)
                 continue;
 
-            std::string bestMatch = "";
-
-            // Find corresponding FunctionPointerUseInfo
-            for (const auto &useEntry : FunctionPointerUses) {
-                const std::vector<FunctionPointerUseInfo> &uses = useEntry.second;
-                for (const auto &use : uses) {
-                    if (use.ModName != edge.CallerModule ||
-                        use.CallerFuncName != edge.CallerFunction ||
-                        use.Line != edge.Line)
-                        continue;
-
-                    // Match this use against FunctionPointerCallMap
-                    for (const auto &callEntry : FunctionPointerCalls) {
-                        const std::vector<FunctionPointerCallInfo> &calls = callEntry.second;
-                        for (const auto &call : calls) {
-                            // Match on module and argument index
-                            if (call.ModName == use.ModName &&
-                                call.ArgIndex == use.ArgIndex) {
-                                bestMatch = call.CalleeFuncName;
-                                break;
-                            }
-                        }
-                        if (!bestMatch.empty()) break;
-                    }
-                }
-                if (!bestMatch.empty()) break;
-            }
+            const SparseBitVector<> &Targets = Solver.Targets(edge.PointerSite);
+            if (Targets.empty())
+                continue;
 
-            // If match found, update the CalleeFunction
-            if (!bestMatch.empty()) {
-                errs() << "[debug] Resolved indirect call at "
-                       << edge.CallerFunction << ":" << edge.Line
-                       << " to " << bestMatch << "\n";
-                edge.CalleeFunction = bestMatch;
-            }
+            for (unsigned Target : Targets)
+                edge.Callees.Insert(Solver.Function(Target));
+
+            LOG_DEBUG(LogResolve) << "Resolved indirect call at "
+                   << SymbolName(edge.CallerFunction) << ":" << edge.Line
+                   << " to " << Targets.count() << " function(s) by propagation";
         }
     }
 }
 
-void CallGraphPass::AnalyzeStaticFPCallSites() {
-    for (auto &modEntry : CallGraph) {
-        std::string ModName = modEntry.first;
-        std::vector<CallEdgeInfo> &edges = modEntry.second;
+// Resolve calls through a named variable to the function stored in it. The
+// variable is looked up in the module holding its definition, following
+// references to globals across modules like a linker.
+void CallGraphPass::AnalyzeGlobalFPCalls(const GlobalSymbolIndex &Globals) {
+    for (auto &group : Facts.CallGraph) {
+        SymbolID ModName = group.Key;
 
-        for (auto &edge : edges) {
-            if (!edge.IsIndirect || edge.CalleeFunction != "indirect")
+        for (auto &edge : group) {
+            if (!edge.IsIndirect)
                 continue;
 
-            const std::string &varName = edge.VarName;
+            SymbolID varName = edge.VarName;
             unsigned offset = edge.Offset;
 
-            if (varName.empty())
+            if (varName == EmptySymbol)
                 continue;
 
-            // Search all entries in FunctionPointerSettings
-            for (const auto &entry : FunctionPointerSettings) {
-                for (const auto &info : entry.second) {
-                    // Ensure we are in the same module and match by VarName and Offset
-                    if (info.ModName != ModName) continue;
-                    if (info.VarName != varName) continue;
-                    if (info.Offset != offset) continue;  // Match by Offset
-
-                    // Match found, resolve the function
-                    edge.CalleeFunction = info.FuncName;
-
-                    errs() << "[debug] Resolved indirect call at "
-                           << edge.CallerFunction << ":" << edge.Line
-                           << " to " << info.FuncName
-                           << " via variable: " << varName
-                           << " with offset: " << offset << "\n";
-                    break;
-                }
+            // Local variables and globals nobody defines stay in the caller's module
+            SymbolID DefModule = Globals.DefiningModule(ModName, varName);
+            if (DefModule == EmptySymbol)
+                DefModule = ModName;
+
+            // Match by defining module, VarName and Offset
+            ArrayRef<SymbolID> Targets = Facts.SettingIndex.Find(DefModule, varName, offset);
+            if (!Targets.empty()) {
+                edge.Callees.Insert(Targets);
+
+                LOG_DEBUG(LogResolve) << "Resolved indirect call at "
+                       << SymbolName(edge.CallerFunction) << ":" << edge.Line
+                       << " to " << Targets.size() << " function(s)"
+                       << " via variable: " << SymbolName(varName)
+                       << " with offset: " << offset;
+                continue;
             }
+
+            // Otherwise any setting of the variable outside of a struct
+            Targets = Facts.SettingIndex.FindNonStruct(DefModule, varName);
+            if (Targets.empty())
+                continue;
+
+            edge.Callees.Insert(Targets);
+
+            LOG_DEBUG(LogResolve) << "Resolved indirect call at "
+                   << SymbolName(edge.CallerFunction) << ":" << edge.Line
+                   << " to " << Targets.size() << " function(s)"
+                   << " via global variable: " << SymbolName(varName);
         }
     }
 }
 
-void CallGraphPass::AnalyzeStaticGlobalFPCalls() {
-    for (auto &modEntry : CallGraph) {
-        std::string ModName = modEntry.first;
-        std::vector<CallEdgeInfo> &edges = modEntry.second;
+void CallGraphPass::ResolveByStructField() {
+    StructFieldIndex Index;
+    Index.Build(Facts.FunctionPointerSettings);
 
-        for (auto &edge : edges) {
-            if (!edge.IsIndirect || edge.CalleeFunction != "indirect")
+    for (auto &group : Facts.CallGraph) {
+        for (auto &edge : group) {
+            if (!edge.IsIndirect || edge.StructTypeName == EmptySymbol)
                 continue;
 
-            const std::string &varName = edge.VarName;
+            ArrayRef<SymbolID> Targets = Index.Lookup(edge.StructTypeName, edge.Offset);
+            if (Targets.empty())
+                continue;
+
+            edge.Callees.Insert(Targets);
+
+            LOG_DEBUG(LogResolve) << "Resolved indirect call at "
+                   << SymbolName(edge.CallerFunction) << ":" << edge.Line
+                   << " to " << Targets.size() << " function(s) stored to "
+                   << SymbolName(edge.StructTypeName) << " field " << edge.Offset;
+        }
+    }
+}
+
+void CallGraphPass::ResolveBySignature() {
+    if (!MaxSignatureTargets)
+        return;
 
-            if (varName.empty())
+    SignatureIndex Index;
+    Index.Build(Facts.ModuleFunctionMap, Facts.AddressTakenFunctions);
+
+    for (auto &group : Facts.CallGraph) {
+        for (auto &edge : group) {
+            // A guess only for calls no other resolver found a target for
+            if (!edge.IsIndirect || !edge.Callees.empty() || edge.Signature == EmptySymbol)
                 continue;
 
-            // Search all entries in FunctionPointerSettings
-            for (const auto &entry : FunctionPointerSettings) {
-                for (const auto &info : entry.second) {
-                    // Must be from same module, not a struct assignment, and matching variable name
-                    if (info.ModName != ModName)
-                        continue;
-                    if (!info.StructTypeName.empty())
-                        continue;
-                    if (info.VarName != varName)
-                        continue;
-
-                    // Match found — update callee function name
-                    edge.CalleeFunction = info.FuncName;
-
-                    errs() << "[debug] Resolved indirect call at "
-                           << edge.CallerFunction << ":" << edge.Line
-                           << " to " << info.FuncName
-                           << " via global variable: " << info.VarName << "\n";
-                    break;
-                }
-            }
+            // Too many candidates say nothing about the target; leave the call unresolved
+            ArrayRef<SymbolID> Targets = Index.Lookup(edge.Signature);
+            if (Targets.empty() || Targets.size() > MaxSignatureTargets)
+                continue;
+
+            edge.Callees.Insert(Targets);
+            edge.TypeMatched = true;
+
+            LOG_DEBUG(LogResolve) << "Resolved indirect call at "
+                   << SymbolName(edge.CallerFunction) << ":" << edge.Line
+                   << " to " << Targets.size() << " function(s) of type " << SymbolName(edge.Signature);
         }
     }
 }
 
 void CallGraphPass::RecordFunctionPointerCall(
-    const std::string &ModName, 
-    const std::string &CallerFuncName, 
-    const std::string &CalleeFuncName, 
+    ModuleFacts &Facts,
+    SymbolID ModName,
+    SymbolID CallerFuncName,
+    SymbolID CalleeFuncName,
     unsigned Line,
     unsigned ArgIndex) {
 
-    std::string key = ModName + ":" + std::to_string(Line) + ":" + std::to_string(ArgIndex);
+    uint64_t key = MakeArgKey(ModName, Line, ArgIndex);
 
     // Create a FunctionPointerCallInfo object
     FunctionPointerCallInfo callInfo{ModName, CallerFuncName, CalleeFuncName, Line, ArgIndex};
 
-    // Insert the call information into the map with the updated key
-    FunctionPointerCalls[key].push_back(callInfo);
+    // Insert the call information into the table with the updated key
+    Facts.FunctionPointerCalls.Append(key, callInfo);
 
     // Optionally log the function pointer call information
-    errs() << "[debug] Recorded function pointer call: " 
-           << "Module: " << ModName 
-           << ", Caller: " << CallerFuncName 
-           << ", Callee: " << CalleeFuncName 
+    LOG_DEBUG(LogCollect) << "Recorded function pointer call: "
+           << "Module: " << SymbolName(ModName)
+           << ", Caller: " << SymbolName(CallerFuncName)
+           << ", Callee: " << SymbolName(CalleeFuncName)
            << " at line: " << Line
-           << " with argument index: " << ArgIndex << "\n";
-}
-
-void CallGraphPass::RecordFunctionPointerUse(
-    const std::string &ModName,
-    const std::string &CallerFuncName,
-    const std::string &CalleeFuncName,
-    unsigned Line,
-    unsigned ArgIndex) {
-
-    std::string key = ModName + ":" + std::to_string(Line) + ":" + std::to_string(ArgIndex);
-    FunctionPointerUseInfo info{ModName, CallerFuncName, CalleeFuncName, Line, ArgIndex};
-    FunctionPointerUses[key].push_back(info);
-
-    errs() << "[debug] Recorded function pointer use: Module: " << ModName
-           << ", Caller: " << CallerFuncName << ", Callee: " << CalleeFuncName
-           << " at line: " << Line << " with argument index: " << ArgIndex << "\n";
+           << " with argument index: " << ArgIndex;
 }
 
 void CallGraphPass::RecordCallGraphEdge(
-    const std::string &ModName,
-    const std::string &CallerFunc,
-    const std::string &CalleeFunc,
+    ModuleFacts &Facts,
+    SymbolID ModName,
+    SymbolID CallerFunc,
+    SymbolID CalleeFunc,
     unsigned Line,
     bool IsIndirect,
-    const std::string &VarName,
-    unsigned Offset) {
+    SymbolID VarName,
+    unsigned Offset,
+    SymbolID Signature,
+    SymbolID StructTypeName,
+    unsigned PointerSite) {
 
     CallEdgeInfo edge;
     edge.CallerModule = ModName;
     edge.CallerFunction = CallerFunc;
-    edge.CalleeFunction = CalleeFunc;
+    if (CalleeFunc != IndirectSymbol)
+        edge.Callees.Insert(CalleeFunc);
     edge.Line = Line;
     edge.IsIndirect = IsIndirect;
     edge.VarName = VarName;
     edge.Offset = Offset;
+    edge.Signature = Signature;
+    edge.StructTypeName = StructTypeName;
+    edge.PointerSite = PointerSite;
+    edge.TypeMatched = false;
+
+    // Calls repeated on a line, e.g. by macro expansion, add nothing to the graph
+    if (!Facts.EdgeKeys.try_emplace(MakeCallEdgeKey(edge, Facts.PointerCallSites), PointerSite).second) {
+        Stats.Add(StatEdgesDeduplicated);
+        return;
+    }
 
-    CallGraph[ModName].push_back(edge);
+    Facts.CallGraph.Append(ModName, std::move(edge));
 
     // Debug print
-    errs() << "[debug] Recorded " << (IsIndirect ? "indirect" : "direct") << " call: "
-           << CallerFunc << " -> " << CalleeFunc
-           << " (line: " << Line << ") in module: " << ModName << "\n";
+    LOG_DEBUG(LogCollect) << "Recorded " << (IsIndirect ? "indirect" : "direct") << " call: "
+           << SymbolName(CallerFunc) << " -> " << SymbolName(CalleeFunc)
+           << " (line: " << Line << ") in module: " << SymbolName(ModName);
 }
@@ -1,6 +1,15 @@
 #pragma once
 #include "Analyzer.h"
 #include <llvm/IR/Module.h>
+#include <llvm/IR/Instructions.h>
+
+#include "CompactCallGraph.h"
+#include "FactTable.h"
+#include "SymbolTable.h"
+#include "TargetSet.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 
 #include <map>
 #include <vector>
@@ -33,114 +42,289 @@ using ModuleFunctionMap = std::map<std::string,
     std::vector<std::tuple<std::string, std::vector<std::string>, 
     std::string>>>>;
 
+// Prototypes of the functions of one module, keyed by function name
+using FunctionProtoTypeMap = ModuleFunctionMap::mapped_type;
+
 
 // FunctionPointerSettingInfo: Stores function pointer setting information with an offset
+// Names are interned in the global SymbolTable.
 struct FunctionPointerSettingInfo {
-    std::string ModName;          // Module name
-    std::string VarName;          // The Variable name
-    std::string SetterName;       // The name of the function or global variable where the pointer is set
-    std::string StructTypeName;   // Struct type name for struct function pointers
-    std::string FuncName;         // The function being pointed to
+    SymbolID ModName;             // Module name
+    SymbolID VarName;             // The Variable name
+    SymbolID SetterName;          // The name of the function or global variable where the pointer is set
+    SymbolID StructTypeName;      // Struct type name for struct function pointers
+    SymbolID FuncName;            // The function being pointed to
     unsigned Line;                // The line number where the pointer is set
     unsigned Offset;              // The offset of the function pointer in the struct
 };
 
-// FunctionPointerSettings: Stores all function pointer settings for a module.
-using FunctionPointerSettings = std::map<std::string, std::vector<FunctionPointerSettingInfo>>;
+// FunctionPointerSettings: Stores all function pointer settings for a module,
+// keyed by MakeLineKey(module, line).
+using FunctionPointerSettings = FactTable<FunctionPointerSettingInfo>;
+
+// FunctionPointerSettingKey: (module, variable) packed with PackSymbols, and
+// the offset a function pointer is stored to
+using FunctionPointerSettingKey = std::pair<uint64_t, unsigned>;
+
+// FunctionPointerSettingIndex: Secondary index over FunctionPointerSettings,
+// kept up to date as settings are inserted. Each key maps to every function
+// stored there, in order of first setting, so a lookup is a single probe.
+struct FunctionPointerSettingIndex {
+    // Keyed on (module, variable, offset)
+    DenseMap<FunctionPointerSettingKey, TargetSet> ByOffset;
+    // Settings outside of any struct, keyed on (module, variable)
+    DenseMap<uint64_t, TargetSet> NonStruct;
+
+    void Insert(const FunctionPointerSettingInfo &info);
+    // Return the functions stored at the key, if any
+    ArrayRef<SymbolID> Find(SymbolID ModName, SymbolID VarName, unsigned Offset) const;
+    ArrayRef<SymbolID> FindNonStruct(SymbolID ModName, SymbolID VarName) const;
+};
 
 // Structure to store information about function pointer calls
 struct FunctionPointerCallInfo {
-    std::string ModName;         // Module name where the function call occurs
-    std::string CallerFuncName;  // Name of the calling function
-    std::string CalleeFuncName;  // Name of the called function
+    SymbolID ModName;            // Module name where the function call occurs
+    SymbolID CallerFuncName;     // Name of the calling function
+    SymbolID CalleeFuncName;     // Name of the called function
     unsigned Line;               // Line number where the function pointer is called
     unsigned ArgIndex;           // Index number of argument parameter
 };
 
-// Map to store FunctionPointerCallInfo, with key as "ModuleName:LineNumber"
-using FunctionPointerCallMap = std::map<std::string, std::vector<FunctionPointerCallInfo>>;
-
-// Structure for function pointer usage (from the callee site, e.g., bar)
-struct FunctionPointerUseInfo {
-    std::string ModName;
-    std::string CallerFuncName; // e.g., bar
-    std::string CalleeFuncName; // typically "indirect"
-    unsigned Line;
-    unsigned ArgIndex;
-};
+// Table to store FunctionPointerCallInfo, keyed by MakeArgKey(module, line, argument index)
+using FunctionPointerCallMap = FactTable<FunctionPointerCallInfo>;
 
-using FunctionPointerUseMap = std::map<std::string, std::vector<FunctionPointerUseInfo>>;
 
+// PointerSite of an edge that is not an indirect call
+const unsigned NoPointerSite = ~0u;
 
 // Call-edge
 // Call-edge structure
 struct CallEdgeInfo {
-    std::string CallerModule;     // Module name where the call occurs
-    std::string CallerFunction;   // Function from which the call is made
-    std::string CalleeFunction;   // Function being called (can be "indirect")
+    SymbolID CallerModule;        // Module name where the call occurs
+    SymbolID CallerFunction;      // Function from which the call is made
+    TargetSet Callees;            // Functions called, none for an unresolved indirect call
     unsigned Line;                // Source line of the call
     bool IsIndirect;              // True if the call is indirect
-    std::string VarName;          // Name of the variable used in the call (only for indirect calls)
+    SymbolID VarName;             // Name of the variable used in the call (only for indirect calls)
     unsigned Offset;              // Offset within struct if applicable (added for matching)
+    SymbolID StructTypeName;      // Struct type whose field Offset holds the called pointer
+    SymbolID Signature;           // Function type of an indirect call, see FunctionSignature()
+    unsigned PointerSite;         // Index into ModuleFacts::PointerCallSites, or NoPointerSite
+    bool TypeMatched;             // Callee was guessed from Signature alone
+};
+
+
+// GlobalSymbolInfo: A global variable a module defines or declares, with the
+// linkage needed to resolve references to it the way a linker would
+struct GlobalSymbolInfo {
+    SymbolID ModName;             // Module declaring or defining the variable
+    SymbolID Name;                // Variable name
+    bool Defined;                 // The module defines it (not just declares it)
+    bool Local;                   // Internal or private linkage, e.g. C static
+    bool Weak;                    // May be overridden by a strong definition
+};
+
+// PointerNode: A place that may hold a function pointer. Values flow between
+// nodes in PropagateFunctionPointers(); struct fields are merged per type
+// and field, whatever object they belong to.
+enum class PointerNodeKind : uint8_t {
+    Argument,       // Formal argument Index of function Scope
+    Return,         // Return value of function Scope
+    Local,          // Stack variable Index (in order of first use) of function Scope in module Name
+    Global,         // Global variable Name as seen from module Scope
+    Field           // Field Index of struct type Scope
+};
+
+struct PointerNode {
+    PointerNodeKind Kind;
+    SymbolID Scope;
+    SymbolID Name;
+    unsigned Index;
+};
+
+// PointerSource: Where a function pointer value comes from, either a node or
+// the address of function Func
+struct PointerSource {
+    PointerNode Node;
+    SymbolID Func;                // EmptySymbol if the value is read from Node
+};
+
+// PointerFlow: Dst may hold whatever Src holds
+struct PointerFlow {
+    PointerNode Dst;
+    PointerSource Src;
+};
+
+// PointerCallSite: An indirect call, with where its called pointer and its
+// function pointer arguments come from
+struct PointerCallSite {
+    std::vector<PointerSource> Callee;
+    // Argument index and the sources of its value
+    std::vector<std::pair<unsigned, PointerSource>> Args;
 };
 
+// Callgraph, keyed by module name
+using ModuleCallGraph = FactTable<CallEdgeInfo>;
 
-// Callgraph
-using ModuleCallGraph = std::map<std::string, std::vector<CallEdgeInfo>>;
+// CallEdgeKey: (caller, callee) and (module, line) packed with PackSymbols,
+// and the CalledValueHash() of an indirect call (0 for direct calls). The
+// callee of an unresolved indirect call is IndirectSymbol, which no direct
+// call has, so the key also tells direct and indirect calls apart. The hash
+// keeps distinct indirect calls on one line, like a->open(x); a->close(y);
+// in a macro, apart.
+using CallEdgeKey = std::tuple<uint64_t, uint64_t, uint64_t>;
 
+inline CallEdgeKey MakeCallEdgeKey(SymbolID ModName, SymbolID Caller, SymbolID Callee, unsigned Line,
+                                   uint64_t CalledValue = 0) {
+    return CallEdgeKey{PackSymbols(Caller, Callee), PackSymbols(ModName, Line), CalledValue};
+}
+
+// Hash of where the called pointer of an indirect call comes from: the
+// variable or struct field it is loaded from, its function type and its
+// sources. Calls on one line with the same hash are the same call.
+uint64_t CalledValueHash(SymbolID VarName, SymbolID StructTypeName, unsigned Offset, SymbolID Signature,
+                         ArrayRef<PointerSource> Callee);
+
+// Key of an edge as recorded, before any resolver added targets. Sites are
+// the PointerCallSites edge.PointerSite indexes.
+CallEdgeKey MakeCallEdgeKey(const CallEdgeInfo &edge, ArrayRef<PointerCallSite> Sites);
+
+// SettingKey: (module, function) and (line, offset) of a recorded setting
+using SettingKey = std::pair<uint64_t, uint64_t>;
+
+// ModuleFacts: Everything the Collect* passes gather.
+// Each module is collected into its own ModuleFacts (a shard) so modules can
+// be processed independently; shards are then merged in input order into the
+// pass-wide ModuleFacts before IdentifyTargets() runs.
+struct ModuleFacts {
+    ::ModuleFunctionMap ModuleFunctionMap;
+    ::FunctionPointerSettings FunctionPointerSettings;
+    FunctionPointerSettingIndex SettingIndex;
+    // Record the function pointer setting along with the offset in the struct
+    DenseSet<SettingKey> ProcessedSettings;
+
+    FunctionPointerCallMap FunctionPointerCalls;
+    ModuleCallGraph CallGraph;
+    // Every edge in CallGraph, to its PointerSite. A call already recorded
+    // at the same line is not recorded again; an identical indirect call
+    // only adds its arguments to the recorded call's site.
+    DenseMap<CallEdgeKey, unsigned> EdgeKeys;
+
+    // Functions whose address is taken in the module (stored, passed, cast),
+    // i.e. the possible targets of indirect calls. May contain duplicates.
+    std::vector<SymbolID> AddressTakenFunctions;
+
+    // Global variables of every module, in module order
+    std::vector<GlobalSymbolInfo> GlobalSymbols;
+
+    // Function pointer flows and the indirect calls they reach
+    std::vector<PointerFlow> PointerFlows;
+    std::vector<PointerCallSite> PointerCallSites;
+
+    // Insert a setting under key and keep SettingIndex up to date
+    void AddFunctionPointerSetting(uint64_t key, const FunctionPointerSettingInfo &info);
+
+    // Append the contents of Shard, preserving the order of its entries.
+    void Merge(ModuleFacts &&Shard);
+    // Replace every symbol S by Map[S], e.g. to move a shard collected with a
+    // SymbolTable of its own over to Symbols. Keys and indexes built from
+    // symbols are rebuilt.
+    void RemapSymbols(ArrayRef<SymbolID> Map);
+    // Put the fact tables in key order once every shard is merged
+    void SortByKey();
+};
+
+
+class FactCache;
+class GlobalSymbolIndex;
 
 class CallGraphPass {
     private:
-        ModuleFunctionMap ModuleFunctionMap;
-        FunctionPointerSettings FunctionPointerSettings;
-        // Record the function pointer setting along with the offset in the struct
-        std::set<std::tuple<std::string, std::string, unsigned, unsigned>> ProcessedSettings;
-
-        FunctionPointerCallMap FunctionPointerCalls;
-        FunctionPointerUseMap FunctionPointerUses;
-        ModuleCallGraph CallGraph;
-
-        void CollectFunctionProtoTypes(Module *M);
-        void CollectStaticFunctionPointerAssignments(Module *M);
-        void CollectCallingAddressTakenFunction(Module *M);
-        void CollectDynamicFunctionPointerAssignments(Module *M);
-        void CollectFunctionPointerArgumentPassing(Module *M);
-        void CollectDirectCalls(Module *M);
-        void AnalyzeIndirectCalls();
-        void ResolveIndirectCalls();
-        void AnalyzeStaticFPCallSites();
-        void AnalyzeStaticGlobalFPCalls();
+        // Facts merged from every module
+        ModuleFacts Facts;
+        // Resolved call graph, frozen by FinalizeCallGraph()
+        CompactCallGraph Graph;
+        unsigned NumThreads;
+        // Load modules listed without IR lazily, one at a time
+        bool Streaming = false;
+        // Most candidates a signature match may add to a call (0 = no matching)
+        unsigned MaxSignatureTargets = 0;
+        // Print the resolved call graph to stderr once targets are identified
+        bool DumpCallGraph = true;
+
+        void CollectFunctionProtoTypes(Module *M, ModuleFacts &Facts);
+        void CollectFunctionProtoType(Function &F, FunctionProtoTypeMap &FuncProtoTypes);
+        void CollectAddressTakenFunctions(Module *M, ModuleFacts &Facts);
+        void CollectGlobalSymbols(Module *M, ModuleFacts &Facts);
+        void CollectStaticFunctionPointerAssignments(Module *M, ModuleFacts &Facts);
+        void CollectNestedStructInitializers(Constant *Init, SymbolID ModName, ModuleFacts &Facts);
+
+        // Per-instruction state shared by the instruction collectors below
+        struct InstructionContext {
+            explicit InstructionContext(SymbolID ModName)
+            : ModName(ModName), FuncName(EmptySymbol), Line(0) { }
+
+            SymbolID ModName;
+            SymbolID FuncName;        // Function containing the instruction
+            unsigned Line;            // Source line of the current call
+            // Stack variables of the function, numbered for PointerNodeKind::Local
+            // by GetPointerNode() in order of first use
+            DenseMap<const Value *, unsigned> Locals;
+        };
+
+        // Single walk over all instructions that drives the collectors below
+        class InstructionFactVisitor;
+        void CollectInstructionFacts(Module *M, ModuleFacts &Facts, uint64_t &NumInstructions);
+        // Same facts for a lazily loaded module, one function body at a time
+        bool CollectLazyModule(Module *M, ModuleFacts &Facts, uint64_t &NumInstructions);
+
+        void CollectCallingAddressTakenFunction(
+            CallInst &call, Value *calledValue, InstructionContext &Ctx, ModuleFacts &Facts);
+        void CollectDynamicFunctionPointerAssignments(
+            StoreInst &store, const InstructionContext &Ctx, ModuleFacts &Facts);
+        void CollectFunctionPointerArgumentPassing(
+            CallBase &call, const InstructionContext &Ctx, ModuleFacts &Facts);
+        void CollectDirectCalls(
+            Function *calleeFunc, const InstructionContext &Ctx, ModuleFacts &Facts);
+        void CollectPointerFlows(Instruction &I, InstructionContext &Ctx, ModuleFacts &Facts);
+        void CollectPointerSources(
+            Value *V, InstructionContext &Ctx, std::vector<PointerSource> &Sources);
+        bool GetPointerNode(Value *Ptr, Type *ValueType, InstructionContext &Ctx, PointerNode &Node);
+        void PropagateFunctionPointers(const GlobalSymbolIndex &Globals);
+        void AnalyzeGlobalFPCalls(const GlobalSymbolIndex &Globals);
+        void ResolveByStructField();
+        void ResolveBySignature();
+        void FinalizeCallGraph();
 
         void RecordFunctionPointerSetting(
-            const std::string &ModName,
-            const std::string &SetterName,
-            const std::string &StructTypeName,
-            const std::string &FuncName,
+            ModuleFacts &Facts,
+            SymbolID ModName,
+            SymbolID SetterName,
+            SymbolID StructTypeName,
+            SymbolID FuncName,
             unsigned Line,
             unsigned Offset);
 
         void RecordFunctionPointerCall(
-            const std::string &ModName, 
-            const std::string &CallerFuncName, 
-            const std::string &CalleeFuncName, 
-            unsigned Line,
-            unsigned ArgIndex);
-
-        void RecordFunctionPointerUse(
-            const std::string &ModName,
-            const std::string &CallerFuncName,
-            const std::string &CalleeFuncName,
+            ModuleFacts &Facts,
+            SymbolID ModName,
+            SymbolID CallerFuncName,
+            SymbolID CalleeFuncName,
             unsigned Line,
             unsigned ArgIndex);
 
         void RecordCallGraphEdge(
-            const std::string &ModName,
-            const std::string &CallerFunc,
-            const std::string &CalleeFunc,
+            ModuleFacts &Facts,
+            SymbolID ModName,
+            SymbolID CallerFunc,
+            SymbolID CalleeFunc,
             unsigned Line,
             bool IsIndirect,
-            const std::string &VarName = "",
-            unsigned Offset = 0);
+            SymbolID VarName = EmptySymbol,
+            unsigned Offset = 0,
+            SymbolID Signature = EmptySymbol,
+            SymbolID StructTypeName = EmptySymbol,
+            unsigned PointerSite = NoPointerSite);
 
         unsigned getLineNumber(const Instruction *I) {
             if (const DebugLoc &DL = I->getDebugLoc()) {
@@ -153,10 +337,20 @@ class CallGraphPass {
     protected:
         const char * ID;
     public:
-        CallGraphPass(const char *ID_)
-        : ID(ID_) { }
+        // NumThreads_ > 1 collects modules concurrently (0 = all cores)
+        CallGraphPass(const char *ID_, unsigned NumThreads_ = 1)
+        : NumThreads(NumThreads_), ID(ID_) { }
         
-        void run(ModuleList &modules);
-        bool CollectInformation(Module *M);
+        // Modules listed without IR (nullptr) are restored from Cache or, when
+        // streaming or the cache entry turns out unreadable, loaded here and
+        // freed as soon as they are collected
+        void run(ModuleList &modules, FactCache *Cache = nullptr);
+        void setStreaming(bool Streaming_) { Streaming = Streaming_; }
+        void setMaxSignatureTargets(unsigned Max) { MaxSignatureTargets = Max; }
+        void setDumpCallGraph(bool Dump) { DumpCallGraph = Dump; }
+        bool CollectInformation(Module *M, ModuleFacts &Facts);
         bool IdentifyTargets(void);
+
+        const CompactCallGraph &getCompactCallGraph() const { return Graph; }
+        const ModuleFacts &getFacts() const { return Facts; }
 };
@@ -0,0 +1,135 @@
+#include "CompactCallGraph.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <algorithm>
+
+struct CompactCallGraph::Storage {
+    std::vector<uint32_t> NameOffsets;
+    std::string NameData;
+    std::vector<FunctionID> NameOrder;
+
+    std::vector<uint32_t> OutOffsets;
+    std::vector<FunctionID> EdgeCallees;
+    std::vector<uint32_t> EdgeLines;
+    std::vector<uint8_t> EdgeFlags;
+
+    std::vector<uint32_t> InOffsets;
+    std::vector<FunctionID> InCallers;
+    std::vector<uint32_t> InEdgeIDs;
+};
+
+CompactCallGraph::CompactCallGraph() = default;
+CompactCallGraph::~CompactCallGraph() = default;
+CompactCallGraph::CompactCallGraph(CompactCallGraph &&) = default;
+CompactCallGraph &CompactCallGraph::operator=(CompactCallGraph &&) = default;
+
+void CompactCallGraph::Attach(const CompactCallGraphArrays &Arrays) {
+    Owned.reset();
+    A = Arrays;
+}
+
+FunctionID CompactCallGraph::Find(StringRef Name) const {
+    auto it = std::lower_bound(A.NameOrder.begin(), A.NameOrder.end(), Name,
+                               [this](FunctionID F, StringRef Name) { return this->Name(F) < Name; });
+    if (it == A.NameOrder.end() || this->Name(*it) != Name)
+        return InvalidFunction;
+    return *it;
+}
+
+void CompactCallGraph::Build(ArrayRef<CompactEdge> Edges) {
+    std::unique_ptr<Storage> S(new Storage());
+
+    // Number the functions and remember each edge's endpoints
+    DenseMap<SymbolID, FunctionID> FunctionIndex;
+    std::vector<SymbolID> FunctionNames;
+    auto AddFunction = [&](SymbolID Name) {
+        auto Inserted = FunctionIndex.try_emplace(Name, (FunctionID)FunctionNames.size());
+        if (Inserted.second)
+            FunctionNames.push_back(Name);
+        return Inserted.first->second;
+    };
+
+    std::vector<FunctionID> Callers(Edges.size()), Targets(Edges.size());
+    for (size_t i = 0; i < Edges.size(); ++i) {
+        Callers[i] = AddFunction(Edges[i].Caller);
+        Targets[i] = AddFunction(Edges[i].Callee);
+    }
+
+    size_t N = FunctionNames.size();
+
+    // Names, so the graph no longer depends on the global symbol table
+    S->NameOffsets.reserve(N + 1);
+    S->NameOffsets.push_back(0);
+    for (SymbolID Name : FunctionNames) {
+        S->NameData += SymbolName(Name).str();
+        S->NameOffsets.push_back(S->NameData.size());
+    }
+
+    // Forward CSR: counting sort of the edges by caller
+    S->OutOffsets.assign(N + 1, 0);
+    for (FunctionID Caller : Callers)
+        ++S->OutOffsets[Caller + 1];
+    for (size_t i = 0; i < N; ++i)
+        S->OutOffsets[i + 1] += S->OutOffsets[i];
+
+    S->EdgeCallees.resize(Edges.size());
+    S->EdgeLines.resize(Edges.size());
+    S->EdgeFlags.resize(Edges.size());
+
+    std::vector<uint32_t> Next(S->OutOffsets.begin(), S->OutOffsets.end() - 1);
+    for (size_t i = 0; i < Edges.size(); ++i) {
+        uint32_t Edge = Next[Callers[i]]++;
+        S->EdgeCallees[Edge] = Targets[i];
+        S->EdgeLines[Edge] = Edges[i].Line;
+        S->EdgeFlags[Edge] = Edges[i].Flags;
+    }
+
+    // Reverse CSR: counting sort of the forward edges by callee
+    S->InOffsets.assign(N + 1, 0);
+    for (FunctionID Callee : S->EdgeCallees)
+        ++S->InOffsets[Callee + 1];
+    for (size_t i = 0; i < N; ++i)
+        S->InOffsets[i + 1] += S->InOffsets[i];
+
+    S->InCallers.resize(Edges.size());
+    S->InEdgeIDs.resize(Edges.size());
+
+    Next.assign(S->InOffsets.begin(), S->InOffsets.end() - 1);
+    for (FunctionID Caller = 0; Caller < N; ++Caller) {
+        for (uint32_t Edge = S->OutOffsets[Caller]; Edge < S->OutOffsets[Caller + 1]; ++Edge) {
+            uint32_t Slot = Next[S->EdgeCallees[Edge]]++;
+            S->InCallers[Slot] = Caller;
+            S->InEdgeIDs[Slot] = Edge;
+        }
+    }
+
+    A.NameOffsets = S->NameOffsets;
+    A.NameData = S->NameData;
+    A.OutOffsets = S->OutOffsets;
+    A.EdgeCallees = S->EdgeCallees;
+    A.EdgeLines = S->EdgeLines;
+    A.EdgeFlags = S->EdgeFlags;
+    A.InOffsets = S->InOffsets;
+    A.InCallers = S->InCallers;
+    A.InEdgeIDs = S->InEdgeIDs;
+
+    // Name lookup is a binary search over the functions sorted by name
+    S->NameOrder.resize(N);
+    for (FunctionID F = 0; F < N; ++F)
+        S->NameOrder[F] = F;
+    std::sort(S->NameOrder.begin(), S->NameOrder.end(),
+              [this](FunctionID L, FunctionID R) { return Name(L) < Name(R); });
+    A.NameOrder = S->NameOrder;
+
+    Owned = std::move(S);
+}
+
+size_t CompactCallGraph::MemoryUsage() const {
+    return A.NameOffsets.size() * sizeof(uint32_t) + A.NameData.size() +
+           A.NameOrder.size() * sizeof(FunctionID) +
+           (A.OutOffsets.size() + A.InOffsets.size()) * sizeof(uint32_t) +
+           (A.EdgeCallees.size() + A.InCallers.size()) * sizeof(FunctionID) +
+           (A.EdgeLines.size() + A.InEdgeIDs.size()) * sizeof(uint32_t) +
+           A.EdgeFlags.size() * sizeof(uint8_t);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "SymbolTable.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// FunctionID: Dense index of a function (node) in a CompactCallGraph
+using FunctionID = uint32_t;
+const FunctionID InvalidFunction = ~0u;
+
+// Edge flags
+enum CompactEdgeFlags : uint8_t {
+    EdgeIndirect = 1 << 0,        // The call was made through a function pointer
+    EdgeTypeMatched = 1 << 1,     // Indirect target guessed from the function type alone
+};
+
+// CompactEdge: A resolved call edge handed to CompactCallGraph::Build
+struct CompactEdge {
+    SymbolID Caller;
+    SymbolID Callee;
+    unsigned Line;
+    uint8_t Flags;
+};
+
+// CompactCallGraphArrays: The flat arrays a CompactCallGraph is made of.
+// N is the number of functions and E the number of edges.
+struct CompactCallGraphArrays {
+    ArrayRef<uint32_t> NameOffsets;     // N + 1 offsets into NameData
+    StringRef NameData;                 // Function names, back to back
+    ArrayRef<FunctionID> NameOrder;     // Functions sorted by name
+
+    ArrayRef<uint32_t> OutOffsets;      // N + 1; out-edges of F are [OutOffsets[F], OutOffsets[F + 1])
+    ArrayRef<FunctionID> EdgeCallees;   // E
+    ArrayRef<uint32_t> EdgeLines;       // E
+    ArrayRef<uint8_t> EdgeFlags;        // E
+
+    ArrayRef<uint32_t> InOffsets;       // N + 1; in-edges of F are [InOffsets[F], InOffsets[F + 1])
+    ArrayRef<FunctionID> InCallers;     // E
+    ArrayRef<uint32_t> InEdgeIDs;       // E, forward edge ID of each in-edge
+};
+
+// CompactCallGraph: Read-only call graph frozen after IdentifyTargets() in
+// compressed-sparse-row form. Functions are numbered 0..NumFunctions()-1 in
+// order of first appearance, and the out-edges of function F are the edge IDs
+// [OutBegin(F), OutEnd(F)) into the parallel per-edge arrays. A reverse
+// (callee -> callers) CSR is kept alongside. Traversals only index into flat
+// arrays and never allocate.
+//
+// The arrays are either owned (Build) or borrowed from memory that outlives
+// the graph, such as a mapped graph file (Attach).
+class CompactCallGraph {
+    public:
+        CompactCallGraph();
+        ~CompactCallGraph();
+        CompactCallGraph(CompactCallGraph &&);
+        CompactCallGraph &operator=(CompactCallGraph &&);
+
+        // Freeze Edges into CSR form. Edges with the same caller keep their order.
+        void Build(ArrayRef<CompactEdge> Edges);
+
+        // Use arrays owned by someone else; they must outlive the graph
+        void Attach(const CompactCallGraphArrays &Arrays);
+        const CompactCallGraphArrays &getArrays() const { return A; }
+
+        size_t NumFunctions() const { return A.OutOffsets.empty() ? 0 : A.OutOffsets.size() - 1; }
+        size_t NumEdges() const { return A.EdgeCallees.size(); }
+
+        StringRef Name(FunctionID F) const {
+            return A.NameData.slice(A.NameOffsets[F], A.NameOffsets[F + 1]);
+        }
+        // Returns InvalidFunction if Name is not part of the graph
+        FunctionID Find(StringRef Name) const;
+
+        // Out-edges of F are the edge IDs OutBegin(F)..OutEnd(F)-1
+        uint32_t OutBegin(FunctionID F) const { return A.OutOffsets[F]; }
+        uint32_t OutEnd(FunctionID F) const { return A.OutOffsets[F + 1]; }
+        ArrayRef<FunctionID> Callees(FunctionID F) const {
+            return A.EdgeCallees.slice(OutBegin(F), OutEnd(F) - OutBegin(F));
+        }
+
+        FunctionID Callee(uint32_t Edge) const { return A.EdgeCallees[Edge]; }
+        unsigned Line(uint32_t Edge) const { return A.EdgeLines[Edge]; }
+        uint8_t Flags(uint32_t Edge) const { return A.EdgeFlags[Edge]; }
+
+        // Callers of F and the matching forward edge IDs, in parallel
+        ArrayRef<FunctionID> Callers(FunctionID F) const {
+            return A.InCallers.slice(A.InOffsets[F], A.InOffsets[F + 1] - A.InOffsets[F]);
+        }
+        ArrayRef<uint32_t> InEdges(FunctionID F) const {
+            return A.InEdgeIDs.slice(A.InOffsets[F], A.InOffsets[F + 1] - A.InOffsets[F]);
+        }
+
+        // Approximate memory held by the arrays, in bytes
+        size_t MemoryUsage() const;
+
+    private:
+        CompactCallGraphArrays A;
+
+        // Backing store of the arrays after Build()
+        struct Storage;
+        std::unique_ptr<Storage> Owned;
+};
@@ -0,0 +1,380 @@
+#include "Condensation.h"
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+static const uint32_t Unvisited = std::numeric_limits<uint32_t>::max();
+
+namespace {
+
+// Part of a function whose component is known
+const uint32_t Done = std::numeric_limits<uint32_t>::max();
+// Parts smaller than this are finished with Tarjan's algorithm in the task
+// that holds them
+const size_t SerialThreshold = 4096;
+
+// SCCFinder: Labels every function of a graph with a component number.
+//
+// Serially this is Tarjan's algorithm with an explicit stack, since call
+// chains can be far deeper than the native stack allows. In parallel it is
+// forward-backward decomposition: functions are split into parts, each
+// owned by one task. A task trims the functions of its part without callers
+// or callees in it (each its own component), then takes the functions
+// reachable from a pivot and the ones reaching it: their intersection is
+// the pivot's component, and the rest of the forward set, the rest of the
+// backward set and the remainder are independent parts handed to new tasks.
+//
+// Per-function scratch arrays are only touched by the task owning the
+// function; Part is atomic because tasks look at their neighbours' parts.
+class SCCFinder {
+    public:
+        SCCFinder(const CompactCallGraph &Graph, std::vector<ComponentID> &Label)
+            : Graph(Graph), Label(Label), N(Graph.NumFunctions()),
+              Part(new std::atomic<uint32_t>[Graph.NumFunctions()]),
+              Index(N), LowLink(N), InDegree(N), OutDegree(N), OnStack(N, 0) {
+            for (FunctionID F = 0; F < N; ++F)
+                Part[F].store(0, std::memory_order_relaxed);
+            Label.assign(N, 0);
+        }
+
+        // Returns the number of components
+        unsigned Run(unsigned NumThreads) {
+            std::vector<FunctionID> All(N);
+            for (FunctionID F = 0; F < N; ++F)
+                All[F] = F;
+
+            if (NumThreads == 1) {
+                Tarjan(0, All);
+            } else {
+                ThreadPool Threads(hardware_concurrency(NumThreads));
+                Pool = &Threads;
+                Spawn(0, std::move(All));
+                Threads.wait();
+                Pool = nullptr;
+            }
+            return NextComponent.load();
+        }
+
+    private:
+        bool In(FunctionID F, uint32_t P) const { return Part[F].load(std::memory_order_relaxed) == P; }
+        void SetPart(FunctionID F, uint32_t P) { Part[F].store(P, std::memory_order_relaxed); }
+
+        void Assign(FunctionID F, ComponentID C) {
+            SetPart(F, Done);
+            Label[F] = C;
+        }
+
+        void Spawn(uint32_t P, std::vector<FunctionID> Nodes) {
+            if (Nodes.empty())
+                return;
+            if (Nodes.size() < SerialThreshold) {
+                Solve(P, std::move(Nodes));
+                return;
+            }
+            Pool->async([this, P, Nodes = std::move(Nodes)]() mutable { Solve(P, std::move(Nodes)); });
+        }
+
+        void Solve(uint32_t P, std::vector<FunctionID> Nodes);
+        void Trim(uint32_t P, std::vector<FunctionID> &Nodes);
+        void Tarjan(uint32_t P, ArrayRef<FunctionID> Nodes);
+
+        const CompactCallGraph &Graph;
+        std::vector<ComponentID> &Label;
+        size_t N;
+        std::unique_ptr<std::atomic<uint32_t>[]> Part;
+        std::atomic<uint32_t> NextPart{1};
+        std::atomic<ComponentID> NextComponent{0};
+        ThreadPool *Pool = nullptr;
+
+        std::vector<uint32_t> Index, LowLink;
+        std::vector<uint32_t> InDegree, OutDegree;
+        std::vector<char> OnStack;
+};
+
+void SCCFinder::Solve(uint32_t P, std::vector<FunctionID> Nodes) {
+    std::vector<FunctionID> Queue;
+
+    while (true) {
+        Trim(P, Nodes);
+        if (Nodes.empty())
+            return;
+        if (Nodes.size() < SerialThreshold) {
+            Tarjan(P, Nodes);
+            return;
+        }
+
+        // Everything the pivot reaches within the part
+        uint32_t Fwd = NextPart++;
+        uint32_t Bwd = NextPart++;
+        FunctionID Pivot = Nodes.front();
+        SetPart(Pivot, Fwd);
+        Queue.assign(1, Pivot);
+        for (size_t i = 0; i < Queue.size(); ++i) {
+            for (FunctionID V : Graph.Callees(Queue[i])) {
+                if (In(V, P)) {
+                    SetPart(V, Fwd);
+                    Queue.push_back(V);
+                }
+            }
+        }
+
+        // Everything reaching the pivot; the part of it the pivot reaches
+        // is its component
+        ComponentID C = NextComponent++;
+        Assign(Pivot, C);
+        Queue.assign(1, Pivot);
+        for (size_t i = 0; i < Queue.size(); ++i) {
+            for (FunctionID U : Graph.Callers(Queue[i])) {
+                if (In(U, Fwd)) {
+                    Assign(U, C);
+                    Queue.push_back(U);
+                } else if (In(U, P)) {
+                    SetPart(U, Bwd);
+                    Queue.push_back(U);
+                }
+            }
+        }
+
+        std::vector<FunctionID> FwdNodes, BwdNodes, Rest;
+        for (FunctionID F : Nodes) {
+            uint32_t FP = Part[F].load(std::memory_order_relaxed);
+            if (FP == Fwd)
+                FwdNodes.push_back(F);
+            else if (FP == Bwd)
+                BwdNodes.push_back(F);
+            else if (FP == P)
+                Rest.push_back(F);
+        }
+        Spawn(Fwd, std::move(FwdNodes));
+        Spawn(Bwd, std::move(BwdNodes));
+        Nodes = std::move(Rest);
+    }
+}
+
+// Peel off functions without callers or without callees in the part, which
+// cannot be on a cycle, until none are left. Most functions go here.
+void SCCFinder::Trim(uint32_t P, std::vector<FunctionID> &Nodes) {
+    std::vector<FunctionID> Queue;
+    for (FunctionID F : Nodes) {
+        InDegree[F] = OutDegree[F] = 0;
+        for (FunctionID V : Graph.Callees(F))
+            OutDegree[F] += In(V, P);
+        for (FunctionID U : Graph.Callers(F))
+            InDegree[F] += In(U, P);
+        if (!InDegree[F] || !OutDegree[F])
+            Queue.push_back(F);
+    }
+
+    for (size_t i = 0; i < Queue.size(); ++i) {
+        FunctionID F = Queue[i];
+        if (!In(F, P))
+            continue;
+        Assign(F, NextComponent++);
+
+        for (FunctionID V : Graph.Callees(F)) {
+            if (In(V, P) && --InDegree[V] == 0)
+                Queue.push_back(V);
+        }
+        for (FunctionID U : Graph.Callers(F)) {
+            if (In(U, P) && --OutDegree[U] == 0)
+                Queue.push_back(U);
+        }
+    }
+
+    Nodes.erase(std::remove_if(Nodes.begin(), Nodes.end(), [&](FunctionID F) { return !In(F, P); }),
+                Nodes.end());
+}
+
+// Tarjan's algorithm over the functions of part P
+void SCCFinder::Tarjan(uint32_t P, ArrayRef<FunctionID> Nodes) {
+    std::vector<FunctionID> Stack;
+    // Function being visited and the next of its out-edges to follow
+    std::vector<std::pair<FunctionID, uint32_t>> Frames;
+    uint32_t NextIndex = 0;
+
+    for (FunctionID F : Nodes)
+        Index[F] = Unvisited;
+
+    auto Enter = [&](FunctionID F) {
+        Index[F] = LowLink[F] = NextIndex++;
+        Stack.push_back(F);
+        OnStack[F] = 1;
+        Frames.push_back({F, Graph.OutBegin(F)});
+    };
+
+    for (FunctionID Root : Nodes) {
+        if (Index[Root] != Unvisited)
+            continue;
+        Enter(Root);
+
+        while (!Frames.empty()) {
+            FunctionID F = Frames.back().first;
+            uint32_t &Edge = Frames.back().second;
+
+            if (Edge < Graph.OutEnd(F)) {
+                FunctionID V = Graph.Callee(Edge++);
+                if (!In(V, P))
+                    continue;
+                if (Index[V] == Unvisited)
+                    Enter(V);
+                else if (OnStack[V])
+                    LowLink[F] = std::min(LowLink[F], Index[V]);
+                continue;
+            }
+
+            Frames.pop_back();
+            if (!Frames.empty()) {
+                FunctionID Parent = Frames.back().first;
+                LowLink[Parent] = std::min(LowLink[Parent], LowLink[F]);
+            }
+
+            if (LowLink[F] != Index[F])
+                continue;
+
+            // Part stays P until the loop is done, so the tests above see
+            // every function of the part
+            ComponentID C = NextComponent++;
+            FunctionID Member;
+            do {
+                Member = Stack.back();
+                Stack.pop_back();
+                OnStack[Member] = 0;
+                Label[Member] = C;
+            } while (Member != F);
+        }
+    }
+
+    for (FunctionID F : Nodes)
+        SetPart(F, Done);
+}
+
+} // namespace
+
+void CondensedCallGraph::Build(const CompactCallGraph &Graph, unsigned NumThreads) {
+    std::vector<ComponentID> Label;
+    unsigned NumComponents = SCCFinder(Graph, Label).Run(NumThreads);
+    Number(Graph, Label, NumComponents);
+}
+
+void CondensedCallGraph::Number(const CompactCallGraph &Graph, ArrayRef<ComponentID> Label,
+                                unsigned NumComponents) {
+    size_t N = Graph.NumFunctions();
+
+    // Components in order of their first function
+    std::vector<ComponentID> Order(NumComponents, Unvisited);
+    ComponentID Next = 0;
+    ComponentOf.resize(N);
+    for (FunctionID F = 0; F < N; ++F) {
+        if (Order[Label[F]] == Unvisited)
+            Order[Label[F]] = Next++;
+        ComponentOf[F] = Order[Label[F]];
+    }
+    BuildArrays(Graph, NumComponents);
+
+    // Reverse post-order of a DFS over the DAG is a topological order
+    std::vector<ComponentID> Topo(NumComponents, Unvisited);
+    std::vector<std::pair<ComponentID, uint32_t>> Frames;
+    uint32_t NextPost = 0;
+    for (ComponentID Root = 0; Root < NumComponents; ++Root) {
+        if (Topo[Root] != Unvisited)
+            continue;
+        Topo[Root] = 0;
+        Frames.push_back({Root, 0});
+
+        while (!Frames.empty()) {
+            ComponentID C = Frames.back().first;
+            uint32_t &Succ = Frames.back().second;
+            if (Succ < Successors(C).size()) {
+                ComponentID D = Successors(C)[Succ++];
+                if (Topo[D] == Unvisited) {
+                    Topo[D] = 0;
+                    Frames.push_back({D, 0});
+                }
+                continue;
+            }
+            Topo[C] = NumComponents - 1 - NextPost++;
+            Frames.pop_back();
+        }
+    }
+
+    for (ComponentID &C : ComponentOf)
+        C = Topo[C];
+    BuildArrays(Graph, NumComponents);
+}
+
+void CondensedCallGraph::BuildArrays(const CompactCallGraph &Graph, unsigned NumComponents) {
+    size_t N = Graph.NumFunctions();
+
+    // Members, by counting sort on the component
+    MemberOffsets.assign(NumComponents + 1, 0);
+    for (ComponentID C : ComponentOf)
+        ++MemberOffsets[C + 1];
+    for (ComponentID C = 0; C < NumComponents; ++C)
+        MemberOffsets[C + 1] += MemberOffsets[C];
+
+    MemberFunctions.resize(N);
+    std::vector<uint32_t> Fill(MemberOffsets.begin(), MemberOffsets.end() - 1);
+    for (FunctionID F = 0; F < N; ++F)
+        MemberFunctions[Fill[ComponentOf[F]]++] = F;
+
+    // DAG edges; LastFrom[D] == C once C -> D is added
+    SuccOffsets.assign(1, 0);
+    SuccOffsets.reserve(NumComponents + 1);
+    Succs.clear();
+    SuccEdges.clear();
+    Cycle.assign(NumComponents, 0);
+    NumCycleComponents = 0;
+    std::vector<ComponentID> LastFrom(NumComponents, Unvisited);
+    for (ComponentID C = 0; C < NumComponents; ++C) {
+        Cycle[C] = Members(C).size() > 1;
+        for (FunctionID F : Members(C)) {
+            for (uint32_t E = Graph.OutBegin(F); E < Graph.OutEnd(F); ++E) {
+                ComponentID D = ComponentOf[Graph.Callee(E)];
+                if (D == C) {
+                    Cycle[C] = 1;
+                    continue;
+                }
+                if (LastFrom[D] == C)
+                    continue;
+                LastFrom[D] = C;
+                Succs.push_back(D);
+                SuccEdges.push_back(E);
+            }
+        }
+        SuccOffsets.push_back(Succs.size());
+        NumCycleComponents += Cycle[C];
+    }
+}
+
+std::string CondensedCallGraph::Label(const CompactCallGraph &Graph, ComponentID C) const {
+    if (IsCycle(C))
+        return "scc#" + std::to_string(C);
+    return Graph.Name(Members(C).front()).str();
+}
+
+void CondensedCallGraph::BuildCallGraph(const CompactCallGraph &Graph, CompactCallGraph &Condensed) const {
+    std::vector<SymbolID> Labels(NumComponents());
+    for (ComponentID C = 0; C < NumComponents(); ++C)
+        Labels[C] = Intern(Label(Graph, C));
+
+    std::vector<CompactEdge> Edges;
+    Edges.reserve(NumEdges());
+    for (ComponentID C = 0; C < NumComponents(); ++C) {
+        ArrayRef<ComponentID> Targets = Successors(C);
+        ArrayRef<uint32_t> Calls = SuccessorEdges(C);
+        for (size_t i = 0; i < Targets.size(); ++i)
+            Edges.push_back({Labels[C], Labels[Targets[i]], Graph.Line(Calls[i]), Graph.Flags(Calls[i])});
+    }
+    Condensed.Build(Edges);
+}
+
+size_t CondensedCallGraph::MemoryUsage() const {
+    return (ComponentOf.size() + Succs.size()) * sizeof(ComponentID) +
+           (MemberOffsets.size() + SuccOffsets.size() + SuccEdges.size()) * sizeof(uint32_t) +
+           MemberFunctions.size() * sizeof(FunctionID) + Cycle.size();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CompactCallGraph.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+// ComponentID: Index of a strongly connected component of a call graph
+using ComponentID = uint32_t;
+
+// CondensedCallGraph: The strongly connected components of a
+// CompactCallGraph and the DAG between them. Components are numbered in
+// topological order, so every DAG edge goes from a lower to a higher ID and
+// a component can only reach components after it. Members and successors
+// are stored in CSR form like the graph itself; DAG edges are deduplicated
+// and have no self loops.
+//
+// The numbering only depends on the graph: components are found serially
+// with Tarjan's algorithm or, with several threads, by forward-backward
+// decomposition, and then numbered the same way.
+class CondensedCallGraph {
+    public:
+        // NumThreads > 1 finds the components in parallel (0 = all cores)
+        void Build(const CompactCallGraph &Graph, unsigned NumThreads = 1);
+
+        size_t NumComponents() const { return MemberOffsets.empty() ? 0 : MemberOffsets.size() - 1; }
+        size_t NumEdges() const { return Succs.size(); }
+
+        ComponentID Component(FunctionID F) const { return ComponentOf[F]; }
+        // Functions of C in FunctionID order
+        ArrayRef<FunctionID> Members(ComponentID C) const {
+            return makeArrayRef(MemberFunctions).slice(MemberOffsets[C], MemberOffsets[C + 1] - MemberOffsets[C]);
+        }
+        ArrayRef<ComponentID> Successors(ComponentID C) const {
+            return makeArrayRef(Succs).slice(SuccOffsets[C], SuccOffsets[C + 1] - SuccOffsets[C]);
+        }
+        // For each successor, the first call of the graph that leads there
+        ArrayRef<uint32_t> SuccessorEdges(ComponentID C) const {
+            return makeArrayRef(SuccEdges).slice(SuccOffsets[C], SuccOffsets[C + 1] - SuccOffsets[C]);
+        }
+
+        // A cycle has several functions or a single recursive one
+        bool IsCycle(ComponentID C) const { return Cycle[C]; }
+        size_t NumCycles() const { return NumCycleComponents; }
+
+        // Name of C in the condensed graph: its function, or "scc#<C>" for a
+        // cycle. '#' does not occur in C identifiers.
+        std::string Label(const CompactCallGraph &Graph, ComponentID C) const;
+
+        // The condensation as a call graph over the labels, one edge per DAG
+        // edge carrying the line and flags of its first call
+        void BuildCallGraph(const CompactCallGraph &Graph, CompactCallGraph &Condensed) const;
+
+        // Memory held by the arrays, in bytes
+        size_t MemoryUsage() const;
+
+    private:
+        // Number components in topological order, visiting components and
+        // successors in order of their first function, and fill the arrays.
+        // Label is any numbering of NumComponents components.
+        void Number(const CompactCallGraph &Graph, ArrayRef<ComponentID> Label, unsigned NumComponents);
+        void BuildArrays(const CompactCallGraph &Graph, unsigned NumComponents);
+
+        std::vector<ComponentID> ComponentOf;       // N
+        std::vector<uint32_t> MemberOffsets;        // C + 1
+        std::vector<FunctionID> MemberFunctions;    // N
+        std::vector<uint32_t> SuccOffsets;          // C + 1
+        std::vector<ComponentID> Succs;
+        std::vector<uint32_t> SuccEdges;            // Parallel to Succs
+        std::vector<char> Cycle;                    // C
+        size_t NumCycleComponents = 0;
+};
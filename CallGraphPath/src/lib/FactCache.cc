@@ -0,0 +1,525 @@
+#include "FactCache.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstring>
+
+// Entry layout, integers in host byte order:
+//
+//   char   Magic[8]
+//   uint32 Version
+//   uint64 Hash                  xxHash64 of the bitcode
+//   string ModuleName            input the entry was collected from
+//   uint64 PayloadHash           xxHash64 of everything that follows
+//   uint32 NumStrings, string Strings[NumStrings]
+//   body                         ModuleFacts, names as indexes into Strings
+//
+// where a string is a uint32 length followed by the bytes.
+static const char FactCacheMagic[8] = {'K', 'A', 'F', 'A', 'C', 'T', 'S', '\0'};
+
+namespace {
+
+// FactWriter: Serializes a shard, replacing symbols by local string indexes
+class FactWriter {
+    public:
+        void U8(uint8_t V) { Body.push_back((char)V); }
+        void U32(uint32_t V) { Body.append((const char *)&V, sizeof(V)); }
+        void U64(uint64_t V) { Body.append((const char *)&V, sizeof(V)); }
+
+        void String(StringRef S) {
+            U32(S.size());
+            Body.append(S.data(), S.size());
+        }
+
+        void Symbol(SymbolID ID) {
+            auto Inserted = Local.try_emplace(ID, (uint32_t)Strings.size());
+            if (Inserted.second)
+                Strings.push_back(SymbolName(ID));
+            U32(Inserted.first->second);
+        }
+
+        // Packed keys keep the module in the high 32 bits
+        void Key(uint64_t Key) {
+            Symbol(KeyModule(Key));
+            U32((uint32_t)Key);
+        }
+
+        void Write(raw_ostream &OS, uint64_t Hash, StringRef ModuleName) {
+            OS.write(FactCacheMagic, sizeof(FactCacheMagic));
+            uint32_t Version = FactCacheVersion;
+            OS.write((const char *)&Version, sizeof(Version));
+            OS.write((const char *)&Hash, sizeof(Hash));
+            WriteString(OS, ModuleName);
+
+            std::string Payload;
+            raw_string_ostream PS(Payload);
+            uint32_t NumStrings = Strings.size();
+            PS.write((const char *)&NumStrings, sizeof(NumStrings));
+            for (StringRef S : Strings)
+                WriteString(PS, S);
+            PS << Body;
+            PS.flush();
+
+            uint64_t PayloadHash = xxHash64(Payload);
+            OS.write((const char *)&PayloadHash, sizeof(PayloadHash));
+            OS << Payload;
+        }
+
+    private:
+        static void WriteString(raw_ostream &OS, StringRef S) {
+            uint32_t Size = S.size();
+            OS.write((const char *)&Size, sizeof(Size));
+            OS << S;
+        }
+
+        std::string Body;
+        DenseMap<SymbolID, uint32_t> Local;
+        std::vector<StringRef> Strings;
+};
+
+// FactReader: Bounds-checked reader for an entry. Every read fails once the
+// data runs out, so a truncated entry is detected by checking ok() at the end.
+class FactReader {
+    public:
+        explicit FactReader(StringRef Data) : Data(Data) {}
+
+        bool ok() const { return OK; }
+        bool done() const { return Pos == Data.size(); }
+        // Reject an entry that reads fine but does not hold together
+        void fail() { OK = false; }
+        StringRef rest() const { return Data.substr(Pos); }
+
+        uint8_t U8() { uint8_t V = 0; Raw(&V, sizeof(V)); return V; }
+        uint32_t U32() { uint32_t V = 0; Raw(&V, sizeof(V)); return V; }
+        uint64_t U64() { uint64_t V = 0; Raw(&V, sizeof(V)); return V; }
+
+        StringRef String() {
+            uint32_t Size = U32();
+            if (!OK || Size > Data.size() - Pos) {
+                OK = false;
+                return StringRef();
+            }
+            StringRef S = Data.substr(Pos, Size);
+            Pos += Size;
+            return S;
+        }
+
+        // Read the string table and intern it into the active symbol table
+        void Strings() {
+            uint32_t Count = U32();
+            for (uint32_t i = 0; OK && i < Count; ++i)
+                Remap.push_back(Intern(String()));
+        }
+
+        SymbolID Symbol() {
+            uint32_t Index = U32();
+            if (Index >= Remap.size()) {
+                OK = false;
+                return EmptySymbol;
+            }
+            return Remap[Index];
+        }
+
+        uint64_t Key() {
+            SymbolID Mod = Symbol();
+            return (uint64_t)Mod << 32 | U32();
+        }
+
+        // Element counts are bounded by the remaining data, so a corrupt count
+        // cannot make the reader loop or allocate for long
+        uint32_t Count() {
+            uint32_t Count = U32();
+            if (Count > Data.size() - Pos)
+                OK = false;
+            return OK ? Count : 0;
+        }
+
+    private:
+        void Raw(void *V, size_t Size) {
+            if (!OK || Size > Data.size() - Pos) {
+                OK = false;
+                return;
+            }
+            memcpy(V, Data.data() + Pos, Size);
+            Pos += Size;
+        }
+
+        StringRef Data;
+        size_t Pos = 0;
+        bool OK = true;
+        std::vector<SymbolID> Remap;
+};
+
+// Read the fixed part of an entry. Returns false unless it is an intact,
+// current entry for Hash collected from ModuleName.
+bool ReadEntryHeader(FactReader &R, uint64_t Hash, StringRef ModuleName) {
+    char Magic[8];
+    for (char &C : Magic)
+        C = R.U8();
+    uint32_t Version = R.U32();
+    uint64_t EntryHash = R.U64();
+    StringRef EntryModule = R.String();
+    uint64_t PayloadHash = R.U64();
+    return R.ok() && memcmp(Magic, FactCacheMagic, sizeof(Magic)) == 0 &&
+           Version == FactCacheVersion && EntryHash == Hash && EntryModule == ModuleName &&
+           xxHash64(R.rest()) == PayloadHash;
+}
+
+void WritePointerSource(FactWriter &W, const PointerSource &Src) {
+    W.U8((uint8_t)Src.Node.Kind);
+    W.Symbol(Src.Node.Scope);
+    W.Symbol(Src.Node.Name);
+    W.U32(Src.Node.Index);
+    W.Symbol(Src.Func);
+}
+
+PointerSource ReadPointerSource(FactReader &R) {
+    PointerSource Src;
+    Src.Node.Kind = (PointerNodeKind)R.U8();
+    Src.Node.Scope = R.Symbol();
+    Src.Node.Name = R.Symbol();
+    Src.Node.Index = R.U32();
+    Src.Func = R.Symbol();
+    return Src;
+}
+
+void WriteFacts(FactWriter &W, const ModuleFacts &Facts) {
+    W.U32(Facts.ModuleFunctionMap.size());
+    for (const auto &modEntry : Facts.ModuleFunctionMap) {
+        W.String(modEntry.first);
+        W.U32(modEntry.second.size());
+        for (const auto &funcEntry : modEntry.second) {
+            W.String(funcEntry.first);
+            W.U32(funcEntry.second.size());
+            for (const auto &proto : funcEntry.second) {
+                W.String(std::get<0>(proto));
+                W.U32(std::get<1>(proto).size());
+                for (const auto &arg : std::get<1>(proto))
+                    W.String(arg);
+                W.String(std::get<2>(proto));
+            }
+        }
+    }
+
+    W.U32(Facts.FunctionPointerSettings.size());
+    for (const auto &group : Facts.FunctionPointerSettings) {
+        W.Key(group.Key);
+        W.U32(group.size());
+        for (const auto &info : group) {
+            W.Symbol(info.ModName);
+            W.Symbol(info.VarName);
+            W.Symbol(info.SetterName);
+            W.Symbol(info.StructTypeName);
+            W.Symbol(info.FuncName);
+            W.U32(info.Line);
+            W.U32(info.Offset);
+        }
+    }
+
+    W.U32(Facts.ProcessedSettings.size());
+    for (const auto &setting : Facts.ProcessedSettings) {
+        W.Symbol(KeyModule(setting.first));
+        W.Symbol((SymbolID)setting.first);
+        W.U64(setting.second);
+    }
+
+    W.U32(Facts.FunctionPointerCalls.size());
+    for (const auto &group : Facts.FunctionPointerCalls) {
+        W.Key(group.Key);
+        W.U32(group.size());
+        for (const auto &info : group) {
+            W.Symbol(info.ModName);
+            W.Symbol(info.CallerFuncName);
+            W.Symbol(info.CalleeFuncName);
+            W.U32(info.Line);
+            W.U32(info.ArgIndex);
+        }
+    }
+
+    W.U32(Facts.CallGraph.size());
+    for (const auto &group : Facts.CallGraph) {
+        W.Symbol(group.Key);
+        W.U32(group.size());
+        for (const auto &edge : group) {
+            W.Symbol(edge.CallerModule);
+            W.Symbol(edge.CallerFunction);
+            W.U32(edge.Callees.size());
+            for (SymbolID Callee : edge.Callees)
+                W.Symbol(Callee);
+            W.U32(edge.Line);
+            W.U8(edge.IsIndirect);
+            W.Symbol(edge.VarName);
+            W.U32(edge.Offset);
+            W.Symbol(edge.StructTypeName);
+            W.Symbol(edge.Signature);
+            W.U32(edge.PointerSite);
+            W.U8(edge.TypeMatched);
+        }
+    }
+
+    W.U32(Facts.AddressTakenFunctions.size());
+    for (SymbolID FuncName : Facts.AddressTakenFunctions)
+        W.Symbol(FuncName);
+
+    W.U32(Facts.GlobalSymbols.size());
+    for (const auto &info : Facts.GlobalSymbols) {
+        W.Symbol(info.ModName);
+        W.Symbol(info.Name);
+        W.U8(info.Defined);
+        W.U8(info.Local);
+        W.U8(info.Weak);
+    }
+
+    // A node is written as a source without a function
+    W.U32(Facts.PointerFlows.size());
+    for (const auto &flow : Facts.PointerFlows) {
+        WritePointerSource(W, {flow.Dst, EmptySymbol});
+        WritePointerSource(W, flow.Src);
+    }
+
+    W.U32(Facts.PointerCallSites.size());
+    for (const auto &site : Facts.PointerCallSites) {
+        W.U32(site.Callee.size());
+        for (const auto &Src : site.Callee)
+            WritePointerSource(W, Src);
+        W.U32(site.Args.size());
+        for (const auto &arg : site.Args) {
+            W.U32(arg.first);
+            WritePointerSource(W, arg.second);
+        }
+    }
+}
+
+void ReadFacts(FactReader &R, ModuleFacts &Facts) {
+    for (uint32_t m = R.Count(); R.ok() && m > 0; --m) {
+        auto &funcs = Facts.ModuleFunctionMap[R.String().str()];
+        for (uint32_t f = R.Count(); R.ok() && f > 0; --f) {
+            auto &protos = funcs[R.String().str()];
+            for (uint32_t p = R.Count(); R.ok() && p > 0; --p) {
+                std::string RetType = R.String().str();
+                std::vector<std::string> Args;
+                for (uint32_t a = R.Count(); R.ok() && a > 0; --a)
+                    Args.push_back(R.String().str());
+                std::string Line = R.String().str();
+                protos.emplace_back(RetType, Args, Line);
+            }
+        }
+    }
+
+    for (uint32_t k = R.Count(); R.ok() && k > 0; --k) {
+        uint64_t key = R.Key();
+        for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+            FunctionPointerSettingInfo info;
+            info.ModName = R.Symbol();
+            info.VarName = R.Symbol();
+            info.SetterName = R.Symbol();
+            info.StructTypeName = R.Symbol();
+            info.FuncName = R.Symbol();
+            info.Line = R.U32();
+            info.Offset = R.U32();
+            Facts.AddFunctionPointerSetting(key, info);
+        }
+    }
+
+    for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+        SymbolID ModName = R.Symbol();
+        SymbolID FuncName = R.Symbol();
+        Facts.ProcessedSettings.insert({PackSymbols(ModName, FuncName), R.U64()});
+    }
+
+    for (uint32_t k = R.Count(); R.ok() && k > 0; --k) {
+        uint64_t key = R.Key();
+        for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+            FunctionPointerCallInfo info;
+            info.ModName = R.Symbol();
+            info.CallerFuncName = R.Symbol();
+            info.CalleeFuncName = R.Symbol();
+            info.Line = R.U32();
+            info.ArgIndex = R.U32();
+            Facts.FunctionPointerCalls.Append(key, info);
+        }
+    }
+
+    for (uint32_t m = R.Count(); R.ok() && m > 0; --m) {
+        SymbolID ModName = R.Symbol();
+        for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+            CallEdgeInfo edge;
+            edge.CallerModule = R.Symbol();
+            edge.CallerFunction = R.Symbol();
+            for (uint32_t j = R.Count(); R.ok() && j > 0; --j)
+                edge.Callees.Insert(R.Symbol());
+            edge.Line = R.U32();
+            edge.IsIndirect = R.U8();
+            edge.VarName = R.Symbol();
+            edge.Offset = R.U32();
+            edge.StructTypeName = R.Symbol();
+            edge.Signature = R.Symbol();
+            edge.PointerSite = R.U32();
+            edge.TypeMatched = R.U8();
+            Facts.CallGraph.Append(ModName, std::move(edge));
+        }
+    }
+
+    for (uint32_t i = R.Count(); R.ok() && i > 0; --i)
+        Facts.AddressTakenFunctions.push_back(R.Symbol());
+
+    for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+        GlobalSymbolInfo info;
+        info.ModName = R.Symbol();
+        info.Name = R.Symbol();
+        info.Defined = R.U8();
+        info.Local = R.U8();
+        info.Weak = R.U8();
+        Facts.GlobalSymbols.push_back(info);
+    }
+
+    for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+        PointerFlow flow;
+        flow.Dst = ReadPointerSource(R).Node;
+        flow.Src = ReadPointerSource(R);
+        Facts.PointerFlows.push_back(flow);
+    }
+
+    for (uint32_t i = R.Count(); R.ok() && i > 0; --i) {
+        PointerCallSite site;
+        for (uint32_t j = R.Count(); R.ok() && j > 0; --j)
+            site.Callee.push_back(ReadPointerSource(R));
+        for (uint32_t j = R.Count(); R.ok() && j > 0; --j) {
+            unsigned ArgIndex = R.U32();
+            site.Args.push_back({ArgIndex, ReadPointerSource(R)});
+        }
+        Facts.PointerCallSites.push_back(std::move(site));
+    }
+
+    // Keys of indirect calls hash the sources of their site, so they are
+    // rebuilt once the sites are read
+    for (const auto &group : Facts.CallGraph) {
+        for (const CallEdgeInfo &edge : group) {
+            if (!R.ok())
+                return;
+            if (edge.PointerSite != NoPointerSite && edge.PointerSite >= Facts.PointerCallSites.size()) {
+                R.fail();
+                return;
+            }
+            Facts.EdgeKeys.try_emplace(MakeCallEdgeKey(edge, Facts.PointerCallSites), edge.PointerSite);
+        }
+    }
+}
+
+} // namespace
+
+FactCache::FactCache(StringRef Dir) : Dir(Dir.str()) {}
+
+bool FactCache::Init(std::string &Error) {
+    if (std::error_code EC = sys::fs::create_directories(Dir)) {
+        Error = EC.message();
+        return false;
+    }
+    return true;
+}
+
+std::string FactCache::EntryPath(uint64_t Hash) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, utohexstr(Hash, /*LowerCase=*/true) + ".facts");
+    return Path.str().str();
+}
+
+bool FactCache::LookupHash(StringRef Filename, uint64_t &Hash) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    auto it = Hashes.find(Filename);
+    if (it == Hashes.end())
+        return false;
+    Hash = it->second;
+    return true;
+}
+
+bool FactCache::Probe(StringRef Filename) {
+    bool Hit = false;
+    auto Input = MemoryBuffer::getFile(Filename, /*IsText=*/false,
+                                       /*RequiresNullTerminator=*/false);
+    if (Input) {
+        uint64_t Hash = xxHash64((*Input)->getBuffer());
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+            Hashes[Filename] = Hash;
+        }
+
+        auto Entry = MemoryBuffer::getFile(EntryPath(Hash), /*IsText=*/false,
+                                           /*RequiresNullTerminator=*/false);
+        if (Entry) {
+            FactReader R((*Entry)->getBuffer());
+            Hit = ReadEntryHeader(R, Hash, Filename);
+        }
+    }
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    ++(Hit ? NumHits : NumMisses);
+    return Hit;
+}
+
+bool FactCache::Load(StringRef Filename, ModuleFacts &Facts) {
+    uint64_t Hash;
+    if (!LookupHash(Filename, Hash))
+        return LoadFailed();
+
+    // The entry may have been replaced or removed since Probe()
+    auto Entry = MemoryBuffer::getFile(EntryPath(Hash), /*IsText=*/false,
+                                       /*RequiresNullTerminator=*/false);
+    if (!Entry)
+        return LoadFailed();
+
+    FactReader R((*Entry)->getBuffer());
+    if (!ReadEntryHeader(R, Hash, Filename))
+        return LoadFailed();
+    R.Strings();
+    ReadFacts(R, Facts);
+    if (!R.ok() || !R.done()) {
+        Facts = ModuleFacts();
+        return LoadFailed();
+    }
+    return true;
+}
+
+bool FactCache::LoadFailed() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    --NumHits;
+    ++NumMisses;
+    return false;
+}
+
+bool FactCache::Store(StringRef Filename, const ModuleFacts &Facts) {
+    uint64_t Hash;
+    if (!LookupHash(Filename, Hash))
+        return false;
+
+    FactWriter W;
+    WriteFacts(W, Facts);
+
+    SmallString<128> TempPath;
+    int FD;
+    if (sys::fs::createUniqueFile(Dir + "/entry-%%%%%%%%.tmp", FD, TempPath))
+        return false;
+
+    {
+        raw_fd_ostream OS(FD, /*shouldClose=*/true);
+        W.Write(OS, Hash, Filename);
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            sys::fs::remove(TempPath);
+            return false;
+        }
+    }
+
+    if (sys::fs::rename(TempPath, EntryPath(Hash))) {
+        sys::fs::remove(TempPath);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CallGraphPass.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Bump when the collectors or the entry layout change, so entries written by
+// an older kanalyzer are treated as misses instead of being trusted.
+const uint32_t FactCacheVersion = 9;
+
+// FactCache: Directory of per-module ModuleFacts shards keyed by the xxHash64
+// of the input bitcode. A module whose bitcode did not change since the last
+// run is restored from its entry instead of being parsed and collected again.
+//
+// Entries store their own string table, so they do not depend on the symbol
+// IDs of the run that wrote them. Entries are written to a temporary file and
+// renamed into place, so concurrent runs never see a partial entry.
+//
+// Probe() is called before parsing; Load() and Store() may be called
+// concurrently for different modules.
+class FactCache {
+    public:
+        explicit FactCache(StringRef Dir);
+
+        // Create the cache directory
+        bool Init(std::string &Error);
+
+        // Hash Filename and check for a valid entry. Returns true on a hit, in
+        // which case the module does not need to be parsed.
+        bool Probe(StringRef Filename);
+
+        // Restore the facts of a module that Probe() reported as a hit. If the
+        // entry cannot be read after all, the hit is counted as a miss and the
+        // module has to be parsed.
+        bool Load(StringRef Filename, ModuleFacts &Facts);
+
+        // Save freshly collected facts of a probed module
+        bool Store(StringRef Filename, const ModuleFacts &Facts);
+
+        unsigned Hits() const { return NumHits; }
+        unsigned Misses() const { return NumMisses; }
+
+    private:
+        std::string EntryPath(uint64_t Hash) const;
+        bool LookupHash(StringRef Filename, uint64_t &Hash);
+        // Turn the hit of a failed Load() into a miss; returns false
+        bool LoadFailed();
+
+        std::string Dir;
+        std::mutex Lock;
+        // Content hash of each probed input
+        StringMap<uint64_t> Hashes;
+        unsigned NumHits = 0;
+        unsigned NumMisses = 0;
+};
@@ -0,0 +1,102 @@
+#include "FactIndex.h"
+
+#include "llvm/ADT/DenseSet.h"
+
+std::string FunctionSignature(StringRef ReturnType, ArrayRef<std::string> ArgTypes) {
+    std::string Signature = ReturnType.str() + " (";
+    for (size_t i = 0; i < ArgTypes.size(); ++i) {
+        if (i)
+            Signature += ", ";
+        Signature += ArgTypes[i];
+    }
+    return Signature + ")";
+}
+
+void SignatureIndex::Build(const ModuleFunctionMap &Prototypes, ArrayRef<SymbolID> AddressTaken) {
+    Targets.clear();
+
+    DenseSet<SymbolID> Candidates(AddressTaken.begin(), AddressTaken.end());
+    // A name defined in several modules is indexed once per distinct signature
+    DenseSet<std::pair<SymbolID, SymbolID>> Indexed;
+
+    for (const auto &modEntry : Prototypes) {
+        for (const auto &funcEntry : modEntry.second) {
+            SymbolID FuncName = Intern(funcEntry.first);
+            if (!Candidates.count(FuncName))
+                continue;
+
+            for (const auto &proto : funcEntry.second) {
+                SymbolID Signature = Intern(FunctionSignature(std::get<0>(proto), std::get<1>(proto)));
+                if (Indexed.insert({Signature, FuncName}).second)
+                    Targets[Signature].push_back(FuncName);
+            }
+        }
+    }
+}
+
+ArrayRef<SymbolID> SignatureIndex::Lookup(SymbolID Signature) const {
+    auto it = Targets.find(Signature);
+    if (it == Targets.end())
+        return ArrayRef<SymbolID>();
+    return it->second;
+}
+
+void StructFieldIndex::Build(const FunctionPointerSettings &Settings) {
+    Targets.clear();
+
+    // The same function stored to a field in several places is indexed once
+    DenseSet<std::pair<uint64_t, SymbolID>> Indexed;
+
+    for (const auto &group : Settings) {
+        for (const auto &info : group) {
+            if (info.StructTypeName == EmptySymbol)
+                continue;
+
+            uint64_t Key = PackSymbols(info.StructTypeName, info.Offset);
+            if (Indexed.insert({Key, info.FuncName}).second)
+                Targets[Key].push_back(info.FuncName);
+        }
+    }
+}
+
+ArrayRef<SymbolID> StructFieldIndex::Lookup(SymbolID StructTypeName, unsigned Field) const {
+    auto it = Targets.find(PackSymbols(StructTypeName, Field));
+    if (it == Targets.end())
+        return ArrayRef<SymbolID>();
+    return it->second;
+}
+
+void GlobalSymbolIndex::Build(ArrayRef<GlobalSymbolInfo> Globals) {
+    Visible.clear();
+    External.clear();
+
+    for (const GlobalSymbolInfo &info : Globals) {
+        if (!info.Defined || info.Local)
+            continue;
+
+        auto it = External.try_emplace(info.Name, &info).first;
+        if (it->second->Weak && !info.Weak)
+            it->second = &info;
+    }
+
+    for (const GlobalSymbolInfo &info : Globals) {
+        uint64_t Key = PackSymbols(info.ModName, info.Name);
+
+        // A module's own static or strong definition hides every other one
+        if (info.Local || (info.Defined && !info.Weak)) {
+            if (info.Defined)
+                Visible[Key] = info.ModName;
+            continue;
+        }
+
+        // Declarations and weak definitions bind to the kept external definition
+        auto def = External.find(info.Name);
+        if (def != External.end())
+            Visible.try_emplace(Key, def->second->ModName);
+    }
+}
+
+SymbolID GlobalSymbolIndex::DefiningModule(SymbolID ModName, SymbolID Name) const {
+    auto it = Visible.find(PackSymbols(ModName, Name));
+    return it == Visible.end() ? EmptySymbol : it->second;
+}
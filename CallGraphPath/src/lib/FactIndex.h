@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CallGraphPass.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include <vector>
+
+// Key of SignatureIndex: return and argument types as stored in
+// ModuleFunctionMap, e.g. "void (i32, i8*)". Varargs are not part of it.
+std::string FunctionSignature(StringRef ReturnType, ArrayRef<std::string> ArgTypes);
+
+// SignatureIndex: Address-taken functions by interned FunctionSignature(),
+// for matching indirect calls by type when no other rule finds a target.
+class SignatureIndex {
+    public:
+        void Build(const ModuleFunctionMap &Prototypes, ArrayRef<SymbolID> AddressTaken);
+
+        // Functions with the signature, in order of first definition
+        ArrayRef<SymbolID> Lookup(SymbolID Signature) const;
+
+    private:
+        DenseMap<SymbolID, std::vector<SymbolID>> Targets;
+};
+
+// StructFieldIndex: Functions stored to each (struct type, field), gathered
+// from the settings of every module, so a call through a struct field finds
+// the functions assigned to that field anywhere in the program in one probe.
+class StructFieldIndex {
+    public:
+        void Build(const FunctionPointerSettings &Settings);
+
+        // Functions stored to the field, in order of first setting
+        ArrayRef<SymbolID> Lookup(SymbolID StructTypeName, unsigned Field) const;
+
+    private:
+        // Keyed on (struct type, field) packed with PackSymbols
+        DenseMap<uint64_t, std::vector<SymbolID>> Targets;
+};
+
+// GlobalSymbolIndex: Linker-style index over the global variables of all
+// modules. A reference from a module binds to that module's own definition
+// if it has one; otherwise it binds to the external definition, a strong one
+// winning over weak ones and earlier modules over later ones. Definitions
+// with local linkage are visible only inside their own module.
+class GlobalSymbolIndex {
+    public:
+        void Build(ArrayRef<GlobalSymbolInfo> Globals);
+
+        // Module whose definition a reference to Name from ModName binds to,
+        // or EmptySymbol if ModName does not know a global by that name or
+        // no module defines it
+        SymbolID DefiningModule(SymbolID ModName, SymbolID Name) const;
+
+    private:
+        // Globals each module defines or declares, keyed on (module, name)
+        // packed with PackSymbols. Maps to the module itself for a definition.
+        DenseMap<uint64_t, SymbolID> Visible;
+        // External definitions by name
+        DenseMap<SymbolID, const GlobalSymbolInfo *> External;
+};
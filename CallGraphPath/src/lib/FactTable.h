@@ -0,0 +1,155 @@
+#pragma once
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+using namespace llvm;
+
+// FactTable: Facts grouped under a 64-bit key, the flat replacement for a
+// std::map of vectors. Facts are bump allocated and chained per key; a
+// DenseMap finds the group of a key, and groups are kept in a vector, in
+// order of first insertion until SortByKey() is called. Nothing is freed one
+// by one: the arenas go away in a few slab frees with the table. Facts must
+// therefore be trivially destructible.
+template <typename InfoT>
+class FactTable {
+    static_assert(std::is_trivially_destructible<InfoT>::value,
+                  "FactTable does not run destructors");
+
+    struct Node {
+        InfoT Info;
+        Node *Next;
+    };
+
+    public:
+        template <typename NodeT, typename ValueT>
+        class Iterator {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = ValueT;
+                using difference_type = std::ptrdiff_t;
+                using pointer = ValueT *;
+                using reference = ValueT &;
+
+                explicit Iterator(NodeT *N = nullptr) : N(N) { }
+                reference operator*() const { return N->Info; }
+                pointer operator->() const { return &N->Info; }
+                Iterator &operator++() { N = N->Next; return *this; }
+                bool operator==(const Iterator &Other) const { return N == Other.N; }
+                bool operator!=(const Iterator &Other) const { return N != Other.N; }
+
+            private:
+                NodeT *N;
+        };
+
+        // Group: The facts of one key, in insertion order
+        class Group {
+            public:
+                using iterator = Iterator<Node, InfoT>;
+                using const_iterator = Iterator<const Node, const InfoT>;
+
+                uint64_t Key;
+
+                iterator begin() { return iterator(Head); }
+                iterator end() { return iterator(); }
+                const_iterator begin() const { return const_iterator(Head); }
+                const_iterator end() const { return const_iterator(); }
+                unsigned size() const { return Size; }
+
+            private:
+                friend class FactTable;
+                Node *Head = nullptr;
+                Node *Tail = nullptr;
+                unsigned Size = 0;
+        };
+
+        FactTable() = default;
+        FactTable(FactTable &&) = default;
+        FactTable &operator=(FactTable &&) = default;
+        FactTable(const FactTable &) = delete;
+        FactTable &operator=(const FactTable &) = delete;
+
+        void Append(uint64_t Key, const InfoT &Info) { Append(Key, InfoT(Info)); }
+        void Append(uint64_t Key, InfoT &&Info) {
+            if (Arenas.empty())
+                Arenas.emplace_back(new BumpPtrAllocator());
+
+            Node *N = new (Arenas.front()->Allocate<Node>()) Node{std::move(Info), nullptr};
+            Link(GetGroup(Key), N, N, 1);
+            ++Count;
+        }
+
+        // Append the facts of Other, keeping their order. Its nodes are
+        // linked in as they are and its arenas taken over, so nothing is
+        // copied. Other is left empty.
+        void Merge(FactTable &&Other) {
+            for (Group &G : Other.Groups) {
+                if (G.Head)
+                    Link(GetGroup(G.Key), G.Head, G.Tail, G.Size);
+            }
+            Count += Other.Count;
+            std::move(Other.Arenas.begin(), Other.Arenas.end(), std::back_inserter(Arenas));
+            Other = FactTable();
+        }
+
+        // Replace every key K by Fn(K), keeping the order of the groups. Fn
+        // must not send two keys to the same one.
+        template <typename FnT>
+        void RemapKeys(FnT Fn) {
+            Index.clear();
+            for (unsigned i = 0; i < Groups.size(); ++i) {
+                Groups[i].Key = Fn(Groups[i].Key);
+                Index[Groups[i].Key] = i;
+            }
+        }
+
+        // Order groups by key, the way the std::map this replaced iterated
+        void SortByKey() {
+            std::sort(Groups.begin(), Groups.end(),
+                      [](const Group &A, const Group &B) { return A.Key < B.Key; });
+            for (unsigned i = 0; i < Groups.size(); ++i)
+                Index[Groups[i].Key] = i;
+        }
+
+        typename std::vector<Group>::iterator begin() { return Groups.begin(); }
+        typename std::vector<Group>::iterator end() { return Groups.end(); }
+        typename std::vector<Group>::const_iterator begin() const { return Groups.begin(); }
+        typename std::vector<Group>::const_iterator end() const { return Groups.end(); }
+
+        // Number of keys
+        unsigned size() const { return Groups.size(); }
+        bool empty() const { return Groups.empty(); }
+        uint64_t NumFacts() const { return Count; }
+
+    private:
+        Group &GetGroup(uint64_t Key) {
+            auto it = Index.try_emplace(Key, Groups.size());
+            if (it.second) {
+                Groups.emplace_back();
+                Groups.back().Key = Key;
+            }
+            return Groups[it.first->second];
+        }
+
+        static void Link(Group &G, Node *First, Node *Last, unsigned Size) {
+            if (G.Tail)
+                G.Tail->Next = First;
+            else
+                G.Head = First;
+            G.Tail = Last;
+            G.Size += Size;
+        }
+
+        std::vector<Group> Groups;
+        DenseMap<uint64_t, unsigned> Index;
+        // New facts go to the first arena; the rest came in with Merge()
+        std::vector<std::unique_ptr<BumpPtrAllocator>> Arenas;
+        uint64_t Count = 0;
+};
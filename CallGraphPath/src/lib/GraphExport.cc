@@ -0,0 +1,209 @@
+#include "GraphExport.h"
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+
+static const size_t ExportBufferSize = 1 << 20;
+
+static StringRef EdgeKind(uint8_t Flags) {
+    if (Flags & EdgeTypeMatched)
+        return "type-matched";
+    return (Flags & EdgeIndirect) ? "indirect" : "direct";
+}
+
+// Write S as a JSON string. Runs of characters that need no escaping, i.e.
+// all of an ordinary symbol name, are written in one piece.
+static void WriteJSONString(raw_ostream &OS, StringRef S) {
+    OS << '"';
+    size_t Begin = 0;
+    for (size_t i = 0; i < S.size(); ++i) {
+        unsigned char C = S[i];
+        if (C != '"' && C != '\\' && C >= 0x20)
+            continue;
+
+        OS << S.slice(Begin, i);
+        if (C == '"' || C == '\\')
+            OS << '\\' << (char)C;
+        else
+            OS << "\\u00" << hexdigit(C >> 4, true) << hexdigit(C & 15, true);
+        Begin = i + 1;
+    }
+    OS << S.substr(Begin) << '"';
+}
+
+// Write S inside a DOT double-quoted string
+static void WriteDOTString(raw_ostream &OS, StringRef S) {
+    OS << '"';
+    size_t Begin = 0;
+    for (size_t i = 0; i < S.size(); ++i) {
+        if (S[i] != '"' && S[i] != '\\')
+            continue;
+
+        OS << S.slice(Begin, i) << '\\' << S[i];
+        Begin = i + 1;
+    }
+    OS << S.substr(Begin) << '"';
+}
+
+// Write S as XML character data
+static void WriteXMLText(raw_ostream &OS, StringRef S) {
+    size_t Begin = 0;
+    for (size_t i = 0; i < S.size(); ++i) {
+        StringRef Entity;
+        switch (S[i]) {
+            case '&': Entity = "&amp;"; break;
+            case '<': Entity = "&lt;"; break;
+            case '>': Entity = "&gt;"; break;
+            case '"': Entity = "&quot;"; break;
+            default: continue;
+        }
+
+        OS << S.slice(Begin, i) << Entity;
+        Begin = i + 1;
+    }
+    OS << S.substr(Begin);
+}
+
+static void ExportText(const CompactCallGraph &Graph, raw_ostream &OS) {
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        StringRef Caller = Graph.Name(F);
+        for (uint32_t E = Graph.OutBegin(F); E < Graph.OutEnd(F); ++E) {
+            OS << Caller << '\t' << Graph.Name(Graph.Callee(E)) << '\t' << Graph.Line(E)
+               << '\t' << EdgeKind(Graph.Flags(E)) << '\n';
+        }
+    }
+}
+
+static void ExportJSONLines(const CompactCallGraph &Graph, raw_ostream &OS) {
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        for (uint32_t E = Graph.OutBegin(F); E < Graph.OutEnd(F); ++E) {
+            OS << "{\"caller\":";
+            WriteJSONString(OS, Graph.Name(F));
+            OS << ",\"callee\":";
+            WriteJSONString(OS, Graph.Name(Graph.Callee(E)));
+            OS << ",\"line\":" << Graph.Line(E) << ",\"kind\":\"" << EdgeKind(Graph.Flags(E)) << "\"}\n";
+        }
+    }
+}
+
+// Functions are nodes n<FunctionID> labelled with their name, so each name is
+// written once. Indirect edges are dashed, type-matched ones dotted.
+static void ExportDOT(const CompactCallGraph &Graph, raw_ostream &OS) {
+    OS << "digraph callgraph {\n";
+    OS << "  node [shape=box];\n";
+
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        OS << "  n" << F << " [label=";
+        WriteDOTString(OS, Graph.Name(F));
+        OS << "];\n";
+    }
+
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        for (uint32_t E = Graph.OutBegin(F); E < Graph.OutEnd(F); ++E) {
+            uint8_t Flags = Graph.Flags(E);
+            OS << "  n" << F << " -> n" << Graph.Callee(E) << " [label=\"" << Graph.Line(E) << '"';
+            if (Flags & EdgeTypeMatched)
+                OS << ", style=dotted";
+            else if (Flags & EdgeIndirect)
+                OS << ", style=dashed";
+            OS << "];\n";
+        }
+    }
+
+    OS << "}\n";
+}
+
+static void ExportGraphML(const CompactCallGraph &Graph, raw_ostream &OS) {
+    OS << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+       << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+       << "  <key id=\"name\" for=\"node\" attr.name=\"name\" attr.type=\"string\"/>\n"
+       << "  <key id=\"line\" for=\"edge\" attr.name=\"line\" attr.type=\"int\"/>\n"
+       << "  <key id=\"kind\" for=\"edge\" attr.name=\"kind\" attr.type=\"string\"/>\n"
+       << "  <graph id=\"callgraph\" edgedefault=\"directed\">\n";
+
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        OS << "    <node id=\"n" << F << "\"><data key=\"name\">";
+        WriteXMLText(OS, Graph.Name(F));
+        OS << "</data></node>\n";
+    }
+
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        for (uint32_t E = Graph.OutBegin(F); E < Graph.OutEnd(F); ++E) {
+            OS << "    <edge source=\"n" << F << "\" target=\"n" << Graph.Callee(E) << "\">"
+               << "<data key=\"line\">" << Graph.Line(E) << "</data>"
+               << "<data key=\"kind\">" << EdgeKind(Graph.Flags(E)) << "</data></edge>\n";
+        }
+    }
+
+    OS << "  </graph>\n</graphml>\n";
+}
+
+void ExportCallGraph(const CompactCallGraph &Graph, ExportFormat Format, raw_ostream &OS) {
+    switch (Format) {
+        case ExportFormat::Text:
+            ExportText(Graph, OS);
+            break;
+        case ExportFormat::JSONLines:
+            ExportJSONLines(Graph, OS);
+            break;
+        case ExportFormat::DOT:
+            ExportDOT(Graph, OS);
+            break;
+        case ExportFormat::GraphML:
+            ExportGraphML(Graph, OS);
+            break;
+    }
+}
+
+void ExportComponents(const CompactCallGraph &Graph, const CondensedCallGraph &DAG, raw_ostream &OS) {
+    for (ComponentID C = 0; C < DAG.NumComponents(); ++C) {
+        if (!DAG.IsCycle(C))
+            continue;
+
+        ArrayRef<FunctionID> Members = DAG.Members(C);
+        OS << "{\"scc\":";
+        WriteJSONString(OS, DAG.Label(Graph, C));
+        OS << ",\"size\":" << Members.size() << ",\"members\":[";
+        for (size_t i = 0; i < Members.size(); ++i) {
+            if (i)
+                OS << ',';
+            WriteJSONString(OS, Graph.Name(Members[i]));
+        }
+        OS << "]}\n";
+    }
+}
+
+static bool WriteFile(StringRef Path, function_ref<void(raw_ostream &)> Write, std::string &Error) {
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+    if (EC) {
+        Error = EC.message();
+        return false;
+    }
+    OS.SetBufferSize(ExportBufferSize);
+
+    Write(OS);
+
+    // stdout is flushed but stays open
+    if (Path == "-")
+        OS.flush();
+    else
+        OS.close();
+    if (OS.has_error()) {
+        Error = OS.error().message();
+        OS.clear_error();
+        return false;
+    }
+    return true;
+}
+
+bool ExportCallGraphFile(const CompactCallGraph &Graph, ExportFormat Format, StringRef Path,
+                         std::string &Error) {
+    return WriteFile(Path, [&](raw_ostream &OS) { ExportCallGraph(Graph, Format, OS); }, Error);
+}
+
+bool ExportComponentsFile(const CompactCallGraph &Graph, const CondensedCallGraph &DAG, StringRef Path,
+                          std::string &Error) {
+    return WriteFile(Path, [&](raw_ostream &OS) { ExportComponents(Graph, DAG, OS); }, Error);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CompactCallGraph.h"
+#include "Condensation.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+using namespace llvm;
+
+enum class ExportFormat {
+    Text,           // One "caller callee line kind" line per edge, tab separated
+    JSONLines,      // One JSON object per edge
+    DOT,            // Graphviz digraph
+    GraphML         // GraphML document with name, line and kind attributes
+};
+
+// Write every edge of Graph to OS in Format. Edges are streamed straight from
+// the CSR arrays, function by function in FunctionID order, and names are
+// escaped as they are written, so nothing is built up in memory.
+void ExportCallGraph(const CompactCallGraph &Graph, ExportFormat Format, raw_ostream &OS);
+
+// Write the members of every cycle of DAG as JSON Lines, one
+// {"scc": label, "size": n, "members": [...]} object per cycle, labelled as
+// in the condensed graph
+void ExportComponents(const CompactCallGraph &Graph, const CondensedCallGraph &DAG, raw_ostream &OS);
+
+// Export Graph, or the cycles of DAG, to the file at Path ("-" for stdout)
+// through a large output buffer. Return false and set Error if the file
+// cannot be written.
+bool ExportCallGraphFile(const CompactCallGraph &Graph, ExportFormat Format, StringRef Path,
+                         std::string &Error);
+bool ExportComponentsFile(const CompactCallGraph &Graph, const CondensedCallGraph &DAG, StringRef Path,
+                          std::string &Error);
@@ -0,0 +1,258 @@
+#include "GraphFile.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const size_t GraphFileAlignment = 8;
+
+// GraphFileWriter: Appends arrays to the output, padding each to the alignment
+class GraphFileWriter {
+    public:
+        explicit GraphFileWriter(raw_ostream &OS) : OS(OS) {}
+
+        void Write(const void *Data, size_t Size) {
+            OS.write((const char *)Data, Size);
+            Pos += Size;
+            while (Pos % GraphFileAlignment) {
+                OS << '\0';
+                ++Pos;
+            }
+        }
+
+        template <typename T>
+        void Write(ArrayRef<T> Array) {
+            Write(Array.data(), Array.size() * sizeof(T));
+        }
+
+    private:
+        raw_ostream &OS;
+        size_t Pos = 0;
+};
+
+// GraphFileReader: Carves the arrays back out of a mapped file
+class GraphFileReader {
+    public:
+        explicit GraphFileReader(StringRef Data) : Data(Data) {}
+
+        template <typename T>
+        bool Read(size_t Count, ArrayRef<T> &Array) {
+            const char *Ptr;
+            if (!Take(Count * sizeof(T), Ptr))
+                return false;
+            if ((uintptr_t)Ptr % alignof(T))
+                return false;
+            Array = ArrayRef<T>((const T *)Ptr, Count);
+            return true;
+        }
+
+        bool Read(size_t Size, StringRef &String) {
+            const char *Ptr;
+            if (!Take(Size, Ptr))
+                return false;
+            String = StringRef(Ptr, Size);
+            return true;
+        }
+
+    private:
+        bool Take(size_t Size, const char *&Ptr) {
+            if (Size > Data.size() - Pos)
+                return false;
+            Ptr = Data.data() + Pos;
+            Pos += Size;
+            Pos = std::min(Data.size(), (Pos + GraphFileAlignment - 1) / GraphFileAlignment * GraphFileAlignment);
+            return true;
+        }
+
+        StringRef Data;
+        size_t Pos = 0;
+};
+
+// Offsets must start at 0, never decrease and end at the size of the data
+// they index
+bool ValidOffsets(ArrayRef<uint32_t> Offsets, uint64_t Size) {
+    if (Offsets.front() != 0 || Offsets.back() != Size)
+        return false;
+    for (size_t i = 1; i < Offsets.size(); ++i) {
+        if (Offsets[i] < Offsets[i - 1])
+            return false;
+    }
+    return true;
+}
+
+bool ValidIDs(ArrayRef<uint32_t> IDs, size_t Limit) {
+    return std::all_of(IDs.begin(), IDs.end(), [Limit](uint32_t ID) { return ID < Limit; });
+}
+
+// One linear pass over everything a query indexes with, so a corrupt file is
+// rejected on open instead of being read out of bounds later
+bool ValidateGraphFile(const CompactCallGraphArrays &A, ArrayRef<uint32_t> SymbolOffsets,
+                       StringRef SymbolData, ArrayRef<GraphFileSetting> Settings) {
+    size_t N = A.NameOrder.size(), E = A.EdgeCallees.size();
+    if (!ValidOffsets(A.NameOffsets, A.NameData.size()) || !ValidOffsets(A.OutOffsets, E) ||
+        !ValidOffsets(A.InOffsets, E) || !ValidOffsets(SymbolOffsets, SymbolData.size()))
+        return false;
+
+    if (!ValidIDs(A.EdgeCallees, N) || !ValidIDs(A.InCallers, N) || !ValidIDs(A.InEdgeIDs, E))
+        return false;
+
+    // NameOrder has to be a permutation of the functions
+    std::vector<char> Seen(N, 0);
+    for (FunctionID F : A.NameOrder) {
+        if (F >= N || Seen[F])
+            return false;
+        Seen[F] = 1;
+    }
+
+    size_t NumSymbols = SymbolOffsets.size() - 1;
+    for (const GraphFileSetting &Setting : Settings) {
+        if (Setting.ModName >= NumSymbols || Setting.VarName >= NumSymbols ||
+            Setting.SetterName >= NumSymbols || Setting.StructTypeName >= NumSymbols ||
+            Setting.FuncName >= NumSymbols)
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool SaveGraphFile(StringRef Path, const CompactCallGraph &Graph,
+                   const FunctionPointerSettings &Settings, std::string &Error) {
+    const CompactCallGraphArrays &A = Graph.getArrays();
+
+    // Snapshot of the symbol table, indexed by SymbolID
+    std::vector<uint32_t> SymbolOffsets;
+    std::string SymbolData;
+    size_t NumSymbols = Symbols.size();
+    SymbolOffsets.reserve(NumSymbols + 1);
+    SymbolOffsets.push_back(0);
+    for (SymbolID ID = 0; ID < NumSymbols; ++ID) {
+        SymbolData += SymbolName(ID).str();
+        SymbolOffsets.push_back(SymbolData.size());
+    }
+
+    std::vector<GraphFileSetting> Records;
+    Records.reserve(Settings.NumFacts());
+    for (const auto &group : Settings) {
+        for (const FunctionPointerSettingInfo &info : group)
+            Records.push_back({info.ModName, info.VarName, info.SetterName, info.StructTypeName,
+                               info.FuncName, info.Line, info.Offset});
+    }
+
+    GraphFileHeader Header;
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, GraphFileMagic, sizeof(Header.Magic));
+    Header.Version = GraphFileVersion;
+    Header.ByteOrder = GraphFileByteOrder;
+    Header.NumFunctions = Graph.NumFunctions();
+    Header.NumEdges = Graph.NumEdges();
+    Header.NumSymbols = NumSymbols;
+    Header.NumSettings = Records.size();
+    Header.NameDataSize = A.NameData.size();
+    Header.SymbolDataSize = SymbolData.size();
+
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+    if (EC) {
+        Error = EC.message();
+        return false;
+    }
+
+    // An empty graph has no offset arrays; write the single 0 they would hold
+    std::vector<uint32_t> EmptyOffsets(1, 0);
+    auto Offsets = [&](ArrayRef<uint32_t> Array) {
+        return Array.empty() ? ArrayRef<uint32_t>(EmptyOffsets) : Array;
+    };
+
+    GraphFileWriter W(OS);
+    W.Write(&Header, sizeof(Header));
+    W.Write(Offsets(A.NameOffsets));
+    W.Write(A.NameData.data(), A.NameData.size());
+    W.Write(A.NameOrder);
+    W.Write(Offsets(A.OutOffsets));
+    W.Write(A.EdgeCallees);
+    W.Write(A.EdgeLines);
+    W.Write(A.EdgeFlags);
+    W.Write(Offsets(A.InOffsets));
+    W.Write(A.InCallers);
+    W.Write(A.InEdgeIDs);
+    W.Write(ArrayRef<uint32_t>(SymbolOffsets));
+    W.Write(SymbolData.data(), SymbolData.size());
+    W.Write(ArrayRef<GraphFileSetting>(Records));
+
+    OS.close();
+    if (OS.has_error()) {
+        Error = OS.error().message();
+        OS.clear_error();
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<GraphFile> GraphFile::Open(StringRef Path, std::string &Error) {
+    // Large files are mapped rather than read
+    auto BufferOrErr = MemoryBuffer::getFile(Path, /*IsText=*/false,
+                                             /*RequiresNullTerminator=*/false);
+    if (!BufferOrErr) {
+        Error = BufferOrErr.getError().message();
+        return nullptr;
+    }
+
+    std::unique_ptr<GraphFile> File(new GraphFile());
+    File->Buffer = std::move(*BufferOrErr);
+    StringRef Data = File->Buffer->getBuffer();
+
+    GraphFileHeader Header;
+    if (Data.size() < sizeof(Header)) {
+        Error = "file too small";
+        return nullptr;
+    }
+    memcpy(&Header, Data.data(), sizeof(Header));
+    if (memcmp(Header.Magic, GraphFileMagic, sizeof(Header.Magic)) != 0) {
+        Error = "not a graph file";
+        return nullptr;
+    }
+    if (Header.ByteOrder != GraphFileByteOrder) {
+        Error = "graph file was written on a host of different byte order";
+        return nullptr;
+    }
+    if (Header.Version != GraphFileVersion) {
+        Error = "unsupported graph file version " + std::to_string(Header.Version);
+        return nullptr;
+    }
+
+    GraphFileReader R(Data);
+    ArrayRef<char> HeaderBytes;
+    CompactCallGraphArrays A;
+    size_t N = Header.NumFunctions, E = Header.NumEdges;
+    bool OK = R.Read(sizeof(Header), HeaderBytes) &&
+              R.Read(N + 1, A.NameOffsets) &&
+              R.Read(Header.NameDataSize, A.NameData) &&
+              R.Read(N, A.NameOrder) &&
+              R.Read(N + 1, A.OutOffsets) &&
+              R.Read(E, A.EdgeCallees) &&
+              R.Read(E, A.EdgeLines) &&
+              R.Read(E, A.EdgeFlags) &&
+              R.Read(N + 1, A.InOffsets) &&
+              R.Read(E, A.InCallers) &&
+              R.Read(E, A.InEdgeIDs) &&
+              R.Read(Header.NumSymbols + 1, File->SymbolOffsets) &&
+              R.Read(Header.SymbolDataSize, File->SymbolData) &&
+              R.Read(Header.NumSettings, File->SettingsArray);
+    if (!OK) {
+        Error = "truncated or misaligned graph file";
+        return nullptr;
+    }
+
+    if (!ValidateGraphFile(A, File->SymbolOffsets, File->SymbolData, File->SettingsArray)) {
+        Error = "corrupt graph file";
+        return nullptr;
+    }
+
+    File->Graph.Attach(A);
+    return File;
+}
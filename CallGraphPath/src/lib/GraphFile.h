@@ -0,0 +1,87 @@
+#pragma once
+
+#include "CallGraphPass.h"
+#include "CompactCallGraph.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Graph file layout (version 1), all integers in host byte order:
+//
+//   GraphFileHeader
+//   uint32 NameOffsets[NumFunctions + 1]      +
+//   char   NameData[NameDataSize]             |
+//   uint32 NameOrder[NumFunctions]            |
+//   uint32 OutOffsets[NumFunctions + 1]       | CompactCallGraphArrays
+//   uint32 EdgeCallees[NumEdges]              |
+//   uint32 EdgeLines[NumEdges]                |
+//   uint8  EdgeFlags[NumEdges]                |
+//   uint32 InOffsets[NumFunctions + 1]        |
+//   uint32 InCallers[NumEdges]                |
+//   uint32 InEdgeIDs[NumEdges]                +
+//   uint32 SymbolOffsets[NumSymbols + 1]     symbol table at save time
+//   char   SymbolData[SymbolDataSize]
+//   GraphFileSetting Settings[NumSettings]   FunctionPointerSettings facts
+//
+// Every array starts on an 8-byte boundary, so a mapped file is used in place.
+const char GraphFileMagic[8] = {'K', 'A', 'C', 'G', 'R', 'A', 'P', 'H'};
+const uint32_t GraphFileVersion = 1;
+const uint32_t GraphFileByteOrder = 0x01020304;
+
+struct GraphFileHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrder;           // Rejects files written on a host of the other endianness
+    uint32_t NumFunctions;
+    uint32_t NumEdges;
+    uint32_t NumSymbols;
+    uint32_t NumSettings;
+    uint64_t NameDataSize;
+    uint64_t SymbolDataSize;
+};
+
+// GraphFileSetting: A FunctionPointerSettingInfo whose names index the
+// file's symbol table
+struct GraphFileSetting {
+    uint32_t ModName;
+    uint32_t VarName;
+    uint32_t SetterName;
+    uint32_t StructTypeName;
+    uint32_t FuncName;
+    uint32_t Line;
+    uint32_t Offset;
+};
+
+// Write Graph, the global symbol table and Settings to Path
+bool SaveGraphFile(StringRef Path, const CompactCallGraph &Graph,
+                   const FunctionPointerSettings &Settings, std::string &Error);
+
+// GraphFile: A graph file mapped into memory. The graph, symbol table and
+// settings are views into the mapping; nothing is copied or re-interned.
+class GraphFile {
+    public:
+        static std::unique_ptr<GraphFile> Open(StringRef Path, std::string &Error);
+
+        const CompactCallGraph &getGraph() const { return Graph; }
+
+        size_t NumSymbols() const { return SymbolOffsets.empty() ? 0 : SymbolOffsets.size() - 1; }
+        StringRef Symbol(uint32_t ID) const {
+            return SymbolData.slice(SymbolOffsets[ID], SymbolOffsets[ID + 1]);
+        }
+
+        ArrayRef<GraphFileSetting> Settings() const { return SettingsArray; }
+
+    private:
+        GraphFile() = default;
+
+        std::unique_ptr<MemoryBuffer> Buffer;
+        CompactCallGraph Graph;
+        ArrayRef<uint32_t> SymbolOffsets;
+        StringRef SymbolData;
+        ArrayRef<GraphFileSetting> SettingsArray;
+};
@@ -0,0 +1,31 @@
+#include "Logger.h"
+
+LogLevel CurrentLogLevel = LogLevel::Warning;
+unsigned EnabledLogCategories = ~0u;
+
+// Serializes writes to stderr between LogLine and LogBlock
+static std::mutex LogLock;
+
+static const char *LevelPrefix(LogLevel Level) {
+    switch (Level) {
+    case LogLevel::Error:   return "[error] ";
+    case LogLevel::Warning: return "[warning] ";
+    case LogLevel::Info:    return "[info] ";
+    case LogLevel::Debug:   return "[debug] ";
+    }
+    return "";
+}
+
+LogLine::LogLine(LogLevel Level) : OS(Buffer) {
+    OS << LevelPrefix(Level);
+}
+
+LogLine::~LogLine() {
+    if (Buffer.empty() || Buffer.back() != '\n')
+        Buffer.push_back('\n');
+
+    std::lock_guard<std::mutex> Guard(LogLock);
+    errs() << Buffer;
+}
+
+LogBlock::LogBlock() : Guard(LogLock) {}
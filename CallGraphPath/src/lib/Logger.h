@@ -0,0 +1,79 @@
+#pragma once
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+
+using namespace llvm;
+
+enum class LogLevel : unsigned {
+    Error,
+    Warning,
+    Info,
+    Debug,
+};
+
+// Log categories, as bit indexes into the enabled category mask
+enum LogCategory : unsigned {
+    LogCollect,      // Facts recorded while walking modules
+    LogResolve,      // Indirect calls attributed to a target
+    LogGraph,        // Compact call graph construction
+    LogDump,         // Full dumps of the collected facts
+};
+
+// Messages above this level are compiled out. Configure with
+// -DENABLE_DEBUG_LOG=OFF to drop debug logging from the hot collection loops.
+#ifndef KANALYZER_MAX_LOG_LEVEL
+#define KANALYZER_MAX_LOG_LEVEL 3
+#endif
+
+// Runtime filters, set once from the command line before any work starts
+extern LogLevel CurrentLogLevel;
+extern unsigned EnabledLogCategories;
+
+inline bool LogEnabled(LogLevel Level, LogCategory Category) {
+    return (unsigned)Level <= KANALYZER_MAX_LOG_LEVEL && Level <= CurrentLogLevel &&
+           // Errors and warnings are never filtered by category
+           (Level <= LogLevel::Warning || (EnabledLogCategories & (1u << Category)));
+}
+
+// LogLine: A single log message. The text is buffered and written with one
+// write when the line goes out of scope, so messages logged by different
+// threads never interleave.
+class LogLine {
+    public:
+        explicit LogLine(LogLevel Level);
+        ~LogLine();
+
+        raw_ostream &stream() { return OS; }
+
+    private:
+        SmallString<256> Buffer;
+        raw_svector_ostream OS;
+};
+
+// LogBlock: Exclusive access to the log for a multi-line dump. The dump is
+// written straight to stderr while other threads wait, instead of being
+// buffered whole.
+class LogBlock {
+    public:
+        LogBlock();
+
+        raw_ostream &stream() { return errs(); }
+
+    private:
+        std::lock_guard<std::mutex> Guard;
+};
+
+// Usage: LOG_DEBUG(LogCollect) << "Recorded ...";
+// When the message is filtered out, the stream expression is not evaluated;
+// when its level is compiled out, it is dead code.
+#define KA_LOG(Level, Category) \
+    if (!LogEnabled(Level, Category)) ; \
+    else LogLine(Level).stream()
+
+#define LOG_ERROR(Category) KA_LOG(LogLevel::Error, Category)
+#define LOG_WARNING(Category) KA_LOG(LogLevel::Warning, Category)
+#define LOG_INFO(Category) KA_LOG(LogLevel::Info, Category)
+#define LOG_DEBUG(Category) KA_LOG(LogLevel::Debug, Category)
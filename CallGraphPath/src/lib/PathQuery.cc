@@ -0,0 +1,337 @@
+#include "PathQuery.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+static const uint32_t Unreached = std::numeric_limits<uint32_t>::max();
+
+PathQuery::PathQuery(const CompactCallGraph &Graph)
+    : Graph(Graph) {
+    size_t N = Graph.NumFunctions();
+    FwdStamp.assign(N, 0);
+    BwdStamp.assign(N, 0);
+    FwdDist.assign(N, 0);
+    BwdDist.assign(N, 0);
+    FwdParent.assign(N, 0);
+    BwdParent.assign(N, 0);
+    FwdPrev.assign(N, InvalidFunction);
+    BwdNext.assign(N, InvalidFunction);
+    OnPath.assign(N, 0);
+}
+
+void PathQuery::NextStamp() {
+    if (++Stamp == 0) {
+        // Wrapped around; old stamps could alias the new ones
+        std::fill(FwdStamp.begin(), FwdStamp.end(), 0);
+        std::fill(BwdStamp.begin(), BwdStamp.end(), 0);
+        Stamp = 1;
+    }
+}
+
+bool PathQuery::ShortestPath(FunctionID From, FunctionID To, unsigned MaxDepth, CallPath &Path) {
+    Path.Source = From;
+    Path.Edges.clear();
+    if (From == To)
+        return true;
+
+    NextStamp();
+    std::vector<FunctionID> Fwd{From}, Bwd{To}, Next;
+    FwdStamp[From] = Stamp;
+    FwdDist[From] = 0;
+    BwdStamp[To] = Stamp;
+    BwdDist[To] = 0;
+
+    unsigned FwdDepth = 0, BwdDepth = 0;
+    // The edge U -> V joining the two searches
+    FunctionID MeetU = InvalidFunction, MeetV = InvalidFunction;
+    uint32_t MeetEdge = 0;
+
+    while (!Fwd.empty() && !Bwd.empty()) {
+        if (MaxDepth && FwdDepth + BwdDepth >= MaxDepth)
+            break;
+
+        // Expand the smaller frontier by one level. Every meeting found in
+        // this level has the same length on the expanded side, so keep the
+        // one closest to the other end.
+        uint32_t Best = Unreached;
+        Next.clear();
+
+        if (Fwd.size() <= Bwd.size()) {
+            ++FwdDepth;
+            for (FunctionID U : Fwd) {
+                for (uint32_t E = Graph.OutBegin(U); E < Graph.OutEnd(U); ++E) {
+                    FunctionID V = Graph.Callee(E);
+                    if (BwdStamp[V] == Stamp && BwdDist[V] < Best) {
+                        Best = BwdDist[V];
+                        MeetU = U;
+                        MeetV = V;
+                        MeetEdge = E;
+                    }
+                    if (FwdStamp[V] == Stamp)
+                        continue;
+                    FwdStamp[V] = Stamp;
+                    FwdDist[V] = FwdDepth;
+                    FwdParent[V] = E;
+                    FwdPrev[V] = U;
+                    Next.push_back(V);
+                }
+            }
+            Fwd.swap(Next);
+        } else {
+            ++BwdDepth;
+            for (FunctionID V : Bwd) {
+                ArrayRef<FunctionID> Callers = Graph.Callers(V);
+                ArrayRef<uint32_t> Edges = Graph.InEdges(V);
+                for (size_t i = 0; i < Callers.size(); ++i) {
+                    FunctionID U = Callers[i];
+                    if (FwdStamp[U] == Stamp && FwdDist[U] < Best) {
+                        Best = FwdDist[U];
+                        MeetU = U;
+                        MeetV = V;
+                        MeetEdge = Edges[i];
+                    }
+                    if (BwdStamp[U] == Stamp)
+                        continue;
+                    BwdStamp[U] = Stamp;
+                    BwdDist[U] = BwdDepth;
+                    BwdParent[U] = Edges[i];
+                    BwdNext[U] = V;
+                    Next.push_back(U);
+                }
+            }
+            Bwd.swap(Next);
+        }
+
+        if (Best != Unreached)
+            break;
+    }
+
+    if (MeetU == InvalidFunction)
+        return false;
+
+    // From -> MeetU, walking the forward parents backwards
+    for (FunctionID F = MeetU; F != From; F = FwdPrev[F])
+        Path.Edges.push_back(FwdParent[F]);
+    std::reverse(Path.Edges.begin(), Path.Edges.end());
+
+    Path.Edges.push_back(MeetEdge);
+
+    // MeetV -> To, following the backward parents
+    for (FunctionID F = MeetV; F != To; F = BwdNext[F])
+        Path.Edges.push_back(BwdParent[F]);
+
+    return true;
+}
+
+void PathQuery::DistancesTo(FunctionID To, unsigned MaxDepth) {
+    NextStamp();
+    std::vector<FunctionID> Level{To}, Next;
+    BwdStamp[To] = Stamp;
+    BwdDist[To] = 0;
+
+    for (unsigned Depth = 1; !Level.empty() && (!MaxDepth || Depth <= MaxDepth); ++Depth) {
+        Next.clear();
+        for (FunctionID V : Level) {
+            for (FunctionID U : Graph.Callers(V)) {
+                if (BwdStamp[U] == Stamp)
+                    continue;
+                BwdStamp[U] = Stamp;
+                BwdDist[U] = Depth;
+                Next.push_back(U);
+            }
+        }
+        Level.swap(Next);
+    }
+}
+
+void PathQuery::MarkParallelEdges() {
+    size_t N = Graph.NumFunctions();
+    ParallelEdge.assign(Graph.NumEdges(), 0);
+
+    // Last caller that reached each callee, as Caller + 1 (0 = none yet)
+    std::vector<uint32_t> SeenBy(N, 0);
+    for (FunctionID Caller = 0; Caller < N; ++Caller) {
+        for (uint32_t E = Graph.OutBegin(Caller); E < Graph.OutEnd(Caller); ++E) {
+            FunctionID Callee = Graph.Callee(E);
+            if (SeenBy[Callee] == Caller + 1)
+                ParallelEdge[E] = 1;
+            SeenBy[Callee] = Caller + 1;
+        }
+    }
+}
+
+bool PathQuery::EnumeratePaths(FunctionID From, FunctionID To, const PathQueryOptions &Options,
+                               std::vector<CallPath> &Paths) {
+    Paths.clear();
+    if (From == To) {
+        Paths.push_back({From, {}});
+        return true;
+    }
+
+    auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(Options.TimeBudgetMs);
+    unsigned Steps = 0;
+
+    if (ParallelEdge.size() != Graph.NumEdges())
+        MarkParallelEdges();
+
+    // Distance of every function to To bounds how deep the search must go
+    DistancesTo(To, Options.MaxDepth);
+    if (BwdStamp[From] != Stamp)
+        return true;
+
+    unsigned Limit = Options.MaxDepth ? Options.MaxDepth : Graph.NumFunctions();
+
+    // Iterative deepening: enumerate all simple paths of exactly Length
+    // calls before trying longer ones, so paths come out shortest first.
+    struct Frame {
+        FunctionID Node;
+        uint32_t NextEdge;
+    };
+    std::vector<Frame> Stack;
+    std::vector<uint32_t> Edges;
+
+    for (unsigned Length = BwdDist[From]; Length <= Limit; ++Length) {
+        bool Pruned = false;   // Whether any path was cut short by Length
+
+        Stack.assign(1, {From, Graph.OutBegin(From)});
+        Edges.clear();
+        OnPath[From] = 1;
+
+        while (!Stack.empty()) {
+            if (Options.TimeBudgetMs && (++Steps & 1023) == 0 &&
+                std::chrono::steady_clock::now() > Deadline) {
+                for (const Frame &F : Stack)
+                    OnPath[F.Node] = 0;
+                return false;
+            }
+
+            Frame &Top = Stack.back();
+            if (Top.NextEdge == Graph.OutEnd(Top.Node)) {
+                OnPath[Top.Node] = 0;
+                Stack.pop_back();
+                if (!Edges.empty())
+                    Edges.pop_back();
+                continue;
+            }
+
+            uint32_t E = Top.NextEdge++;
+            FunctionID V = Graph.Callee(E);
+            unsigned Depth = Edges.size() + 1;
+
+            if (OnPath[V] || BwdStamp[V] != Stamp)
+                continue;
+            if (Depth + BwdDist[V] > Length) {
+                Pruned = true;
+                continue;
+            }
+            // Parallel edges (same callee, other lines) give the same path
+            if (ParallelEdge[E])
+                continue;
+
+            if (V == To) {
+                if (Depth == Length) {
+                    Edges.push_back(E);
+                    Paths.push_back({From, Edges});
+                    Edges.pop_back();
+                    if (Paths.size() >= Options.MaxPaths) {
+                        for (const Frame &F : Stack)
+                            OnPath[F.Node] = 0;
+                        return true;
+                    }
+                }
+                continue;
+            }
+
+            OnPath[V] = 1;
+            Edges.push_back(E);
+            Stack.push_back({V, Graph.OutBegin(V)});
+        }
+
+        // No longer path can exist if nothing was cut by the length bound
+        if (!Pruned)
+            break;
+    }
+
+    return true;
+}
+
+void PrintCallPath(const CompactCallGraph &Graph, const CallPath &Path, std::ostream &OS) {
+    OS << Graph.Name(Path.Source).str();
+    for (uint32_t E : Path.Edges) {
+        OS << " -> " << Graph.Name(Graph.Callee(E)).str()
+           << " (line " << Graph.Line(E) << ")";
+    }
+}
+
+bool RunPathQuery(const CompactCallGraph &Graph, StringRef From, StringRef To,
+                  const PathQueryOptions &Options, std::ostream &OS) {
+    FunctionID Source = Graph.Find(From);
+    FunctionID Sink = Graph.Find(To);
+    if (Source == InvalidFunction || Sink == InvalidFunction) {
+        std::cerr << "Function not found in call graph: "
+                  << (Source == InvalidFunction ? From : To).str() << std::endl;
+        return false;
+    }
+
+    OS << "Path query: " << From.str() << " -> " << To.str() << std::endl;
+
+    PathQuery Query(Graph);
+    std::vector<CallPath> Paths;
+    bool Complete = true;
+
+    if (Options.MaxPaths <= 1) {
+        CallPath Path;
+        if (Query.ShortestPath(Source, Sink, Options.MaxDepth, Path))
+            Paths.push_back(std::move(Path));
+    } else {
+        Complete = Query.EnumeratePaths(Source, Sink, Options, Paths);
+    }
+
+    if (Paths.empty())
+        OS << "No path found" << std::endl;
+
+    for (size_t i = 0; i < Paths.size(); ++i) {
+        OS << "Path " << i + 1 << " (" << Paths[i].Edges.size() << " calls): ";
+        PrintCallPath(Graph, Paths[i], OS);
+        OS << std::endl;
+    }
+
+    if (!Complete)
+        OS << "Time budget exhausted after " << Paths.size() << " path(s)" << std::endl;
+
+    return true;
+}
+
+bool RunCondensedPathQuery(const CompactCallGraph &Graph, const CondensedCallGraph &DAG,
+                           const CompactCallGraph &Condensed, StringRef From, StringRef To,
+                           const PathQueryOptions &Options, std::ostream &OS) {
+    FunctionID Source = Graph.Find(From);
+    FunctionID Sink = Graph.Find(To);
+    if (Source == InvalidFunction || Sink == InvalidFunction) {
+        std::cerr << "Function not found in call graph: "
+                  << (Source == InvalidFunction ? From : To).str() << std::endl;
+        return false;
+    }
+
+    ComponentID U = DAG.Component(Source);
+    ComponentID V = DAG.Component(Sink);
+    std::string FromLabel = DAG.Label(Graph, U);
+    std::string ToLabel = DAG.Label(Graph, V);
+
+    if (U == V && DAG.IsCycle(U)) {
+        OS << "Path query: " << From.str() << " -> " << To.str() << std::endl;
+        OS << "Both functions are in " << FromLabel << " (" << DAG.Members(U).size()
+           << " functions)" << std::endl;
+        return true;
+    }
+
+    // A component without calls in or out of it is not part of Condensed
+    if (Condensed.Find(FromLabel) == InvalidFunction || Condensed.Find(ToLabel) == InvalidFunction) {
+        OS << "Path query: " << FromLabel << " -> " << ToLabel << std::endl;
+        OS << "No path found" << std::endl;
+        return true;
+    }
+
+    return RunPathQuery(Condensed, FromLabel, ToLabel, Options, OS);
+}
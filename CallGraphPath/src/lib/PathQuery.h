@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CompactCallGraph.h"
+#include "Condensation.h"
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+// CallPath: A call path from Source, as the forward edge IDs taken in order
+struct CallPath {
+    FunctionID Source;
+    std::vector<uint32_t> Edges;
+};
+
+struct PathQueryOptions {
+    unsigned MaxDepth = 0;        // Maximum number of calls on a path (0 = unlimited)
+    unsigned MaxPaths = 1;        // Number of paths to enumerate
+    unsigned TimeBudgetMs = 0;    // Give up enumerating after this long (0 = unlimited)
+};
+
+// PathQuery: Source -> sink path queries over a CompactCallGraph.
+// Scratch arrays are sized once per graph and reused between queries.
+class PathQuery {
+    public:
+        PathQuery(const CompactCallGraph &Graph);
+
+        // Shortest path from From to To using bidirectional BFS. Returns false
+        // if To is not reachable within MaxDepth calls.
+        bool ShortestPath(FunctionID From, FunctionID To, unsigned MaxDepth, CallPath &Path);
+
+        // Enumerate up to Options.MaxPaths simple paths (no function repeated)
+        // from From to To, shortest first. Returns false if the time budget
+        // ran out before the enumeration finished.
+        bool EnumeratePaths(FunctionID From, FunctionID To, const PathQueryOptions &Options,
+                            std::vector<CallPath> &Paths);
+
+    private:
+        const CompactCallGraph &Graph;
+
+        // Visit stamps avoid clearing the scratch arrays between queries
+        std::vector<uint32_t> FwdStamp, BwdStamp;
+        std::vector<uint32_t> FwdDist, BwdDist;
+        // Edge (forward edge ID) and neighbour each function was reached through
+        std::vector<uint32_t> FwdParent, BwdParent;
+        std::vector<FunctionID> FwdPrev, BwdNext;
+        uint32_t Stamp = 0;
+
+        std::vector<char> OnPath;
+        // Set for an edge whose caller has an earlier edge to the same callee
+        std::vector<char> ParallelEdge;
+
+        void NextStamp();
+        // Backward BFS from To filling BwdDist, up to MaxDepth levels
+        void DistancesTo(FunctionID To, unsigned MaxDepth);
+        // Fill ParallelEdge, once per graph, in one pass over the edges
+        void MarkParallelEdges();
+};
+
+void PrintCallPath(const CompactCallGraph &Graph, const CallPath &Path, std::ostream &OS);
+
+// Answer a --from/--to query and print the paths found to OS.
+// Returns false if either function is not part of the graph.
+bool RunPathQuery(const CompactCallGraph &Graph, StringRef From, StringRef To,
+                  const PathQueryOptions &Options, std::ostream &OS);
+
+// Same query on Condensed, the call graph DAG.BuildCallGraph() made of Graph.
+// From and To are looked up in Graph and the paths run between their
+// components, so a cycle on the way is a single scc#N step.
+bool RunCondensedPathQuery(const CompactCallGraph &Graph, const CondensedCallGraph &DAG,
+                           const CompactCallGraph &Condensed, StringRef From, StringRef To,
+                           const PathQueryOptions &Options, std::ostream &OS);
@@ -0,0 +1,124 @@
+#include "PointerFlow.h"
+#include "FactIndex.h"
+
+void PointerFlowSolver::Solve(const ModuleFacts &Facts, const GlobalSymbolIndex &Globals_) {
+    Globals = &Globals_;
+    Sites = &Facts.PointerCallSites;
+
+    // Function addresses stored by static initializers and to struct fields
+    for (const auto &group : Facts.FunctionPointerSettings) {
+        for (const auto &info : group) {
+            PointerSource Src{{}, info.FuncName};
+            if (info.StructTypeName != EmptySymbol)
+                AddSource(Src, NodeID({PointerNodeKind::Field, info.StructTypeName, EmptySymbol, info.Offset}));
+            else if (info.VarName != EmptySymbol && !IsDiscarded(info.ModName, info.VarName))
+                AddSource(Src, NodeID({PointerNodeKind::Global, info.ModName, info.VarName, 0}));
+        }
+    }
+
+    for (const PointerFlow &flow : Facts.PointerFlows)
+        AddSource(flow.Src, NodeID(flow.Dst));
+
+    for (unsigned Site = 0; Site < Sites->size(); ++Site) {
+        unsigned Node = NewNode();
+        SiteNodes.push_back(Node);
+        SiteOfNode[Node] = Site;
+        Bound.emplace_back();
+        for (const PointerSource &Src : (*Sites)[Site].Callee)
+            AddSource(Src, Node);
+    }
+
+    while (!Worklist.empty()) {
+        unsigned Node = Worklist.back();
+        Worklist.pop_back();
+        Queued[Node] = false;
+        ++Steps;
+
+        auto site = SiteOfNode.find(Node);
+        if (site != SiteOfNode.end())
+            BindArguments(site->second);
+
+        for (unsigned i = 0; i < Succs[Node].size(); ++i) {
+            unsigned Succ = Succs[Node][i];
+            if (PointsTo[Succ] |= PointsTo[Node])
+                Push(Succ);
+        }
+    }
+}
+
+// A weak definition overridden by a strong one elsewhere, whose initializer
+// the linker would drop
+bool PointerFlowSolver::IsDiscarded(SymbolID ModName, SymbolID VarName) const {
+    SymbolID DefModule = Globals->DefiningModule(ModName, VarName);
+    return DefModule != EmptySymbol && DefModule != ModName;
+}
+
+unsigned PointerFlowSolver::NewNode() {
+    PointsTo.emplace_back();
+    Succs.emplace_back();
+    Queued.push_back(false);
+    return PointsTo.size() - 1;
+}
+
+unsigned PointerFlowSolver::NodeID(const PointerNode &Node) {
+    SymbolID Scope = Node.Scope;
+
+    // All modules referring to a global share the node of its definition
+    if (Node.Kind == PointerNodeKind::Global) {
+        SymbolID DefModule = Globals->DefiningModule(Scope, Node.Name);
+        if (DefModule != EmptySymbol)
+            Scope = DefModule;
+    }
+
+    auto it = Nodes.try_emplace(NodeKey{(uint8_t)Node.Kind, Scope, Node.Name, Node.Index}, 0);
+    if (it.second)
+        it.first->second = NewNode();
+    return it.first->second;
+}
+
+unsigned PointerFlowSolver::FunctionNumber(SymbolID Func) {
+    auto it = FunctionNumbers.try_emplace(Func, Functions.size());
+    if (it.second)
+        Functions.push_back(Func);
+    return it.first->second;
+}
+
+void PointerFlowSolver::AddSource(const PointerSource &Src, unsigned To) {
+    if (Src.Func != EmptySymbol) {
+        if (PointsTo[To].test_and_set(FunctionNumber(Src.Func)))
+            Push(To);
+        return;
+    }
+
+    AddEdge(NodeID(Src.Node), To);
+}
+
+void PointerFlowSolver::AddEdge(unsigned From, unsigned To) {
+    if (From == To || !Edges.insert((uint64_t)From << 32 | To).second)
+        return;
+
+    Succs[From].push_back(To);
+    if (PointsTo[To] |= PointsTo[From])
+        Push(To);
+}
+
+void PointerFlowSolver::Push(unsigned Node) {
+    if (Queued[Node])
+        return;
+    Queued[Node] = true;
+    Worklist.push_back(Node);
+}
+
+void PointerFlowSolver::BindArguments(unsigned Site) {
+    const PointerCallSite &Call = (*Sites)[Site];
+
+    // Binding adds nodes, which may move PointsTo; work on a copy
+    SparseBitVector<> New = PointsTo[SiteNodes[Site]];
+    New.intersectWithComplement(Bound[Site]);
+    Bound[Site] |= New;
+
+    for (unsigned Target : New) {
+        for (const auto &arg : Call.Args)
+            AddSource(arg.second, NodeID({PointerNodeKind::Argument, Functions[Target], EmptySymbol, arg.first}));
+    }
+}
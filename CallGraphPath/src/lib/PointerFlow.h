@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CallGraphPass.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/SparseBitVector.h"
+
+#include <tuple>
+#include <vector>
+
+class GlobalSymbolIndex;
+
+// PointerFlowSolver: Flow-insensitive propagation of function addresses over
+// the PointerFlows of all modules, run with a worklist until nothing changes.
+// Points-to sets are SparseBitVectors over the functions numbered in order of
+// first appearance in the facts, so they iterate in an order that follows
+// the modules rather than the symbol table. An indirect call
+// passes its function pointer arguments to the formals of every target found
+// for it so far, so targets and points-to sets are discovered together.
+class PointerFlowSolver {
+    public:
+        // Globals binds references to global variables to their definitions
+        void Solve(const ModuleFacts &Facts, const GlobalSymbolIndex &Globals);
+
+        // Functions the called pointer of PointerCallSites[Site] may hold,
+        // as numbers for Function()
+        const SparseBitVector<> &Targets(unsigned Site) const { return PointsTo[SiteNodes[Site]]; }
+        SymbolID Function(unsigned Number) const { return Functions[Number]; }
+
+        unsigned NumNodes() const { return PointsTo.size(); }
+        // Nodes taken off the worklist
+        uint64_t NumSteps() const { return Steps; }
+
+    private:
+        using NodeKey = std::tuple<uint8_t, SymbolID, SymbolID, unsigned>;
+
+        bool IsDiscarded(SymbolID ModName, SymbolID VarName) const;
+        unsigned NewNode();
+        unsigned NodeID(const PointerNode &Node);
+        unsigned FunctionNumber(SymbolID Func);
+        // Make To hold whatever Src holds
+        void AddSource(const PointerSource &Src, unsigned To);
+        void AddEdge(unsigned From, unsigned To);
+        void Push(unsigned Node);
+        // Feed the arguments of Site to the formals of its new targets
+        void BindArguments(unsigned Site);
+
+        const GlobalSymbolIndex *Globals = nullptr;
+        const std::vector<PointerCallSite> *Sites = nullptr;
+
+        DenseMap<NodeKey, unsigned> Nodes;
+        DenseMap<SymbolID, unsigned> FunctionNumbers;
+        std::vector<SymbolID> Functions;
+        std::vector<SparseBitVector<>> PointsTo;
+        std::vector<SmallVector<unsigned, 2>> Succs;
+        // Copy edges already added, as From << 32 | To
+        DenseSet<uint64_t> Edges;
+
+        // Node holding the targets of each call site, and the reverse map
+        std::vector<unsigned> SiteNodes;
+        DenseMap<unsigned, unsigned> SiteOfNode;
+        // Targets whose formals a call site has been bound to
+        std::vector<SparseBitVector<>> Bound;
+
+        std::vector<unsigned> Worklist;
+        std::vector<bool> Queued;
+        uint64_t Steps = 0;
+};
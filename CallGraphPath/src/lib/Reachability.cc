@@ -0,0 +1,183 @@
+#include "Reachability.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <algorithm>
+#include <limits>
+
+// Order in which labeling L visits K roots or successors: as stored,
+// reversed, and rotated by half, so that the labelings differ
+static uint32_t VisitOrder(unsigned L, uint32_t i, uint32_t K) {
+    switch (L % 3) {
+        case 0: return i;
+        case 1: return K - 1 - i;
+        default: return (i + K / 2) % K;
+    }
+}
+
+void ReachabilityIndex::Build(const CompactCallGraph &Graph, unsigned NumThreads) {
+    DAG.Build(Graph, NumThreads);
+    size_t NumComponents = DAG.NumComponents();
+
+    std::vector<char> HasCaller(NumComponents, 0);
+    for (ComponentID C = 0; C < NumComponents; ++C) {
+        for (ComponentID D : DAG.Successors(C))
+            HasCaller[D] = 1;
+    }
+    std::vector<ComponentID> Roots;
+    for (ComponentID C = 0; C < NumComponents; ++C) {
+        if (!HasCaller[C])
+            Roots.push_back(C);
+    }
+
+    Labels.assign(NumComponents * NumLabelings, {0, 0});
+    TreeStart.assign(NumComponents, 0);
+    for (unsigned L = 0; L < NumLabelings; ++L)
+        Label(L, Roots);
+
+    Visited.assign(NumComponents, 0);
+    Stamp = 0;
+}
+
+// Post-order DFS from every root. Low of a component is the lowest post-order
+// number among the components it reaches; in a DAG every successor seen
+// before is already finished, so its Low is final.
+void ReachabilityIndex::Label(unsigned Labeling, ArrayRef<ComponentID> Roots) {
+    std::vector<char> Seen(DAG.NumComponents(), 0);
+    // Component being visited and the number of its successors followed
+    std::vector<std::pair<ComponentID, uint32_t>> Frames;
+    uint32_t NextPost = 0;
+
+    auto Enter = [&](ComponentID C) {
+        Seen[C] = 1;
+        Labels[C * NumLabelings + Labeling].Low = std::numeric_limits<uint32_t>::max();
+        if (Labeling == 0)
+            TreeStart[C] = NextPost;
+        Frames.push_back({C, 0});
+    };
+
+    for (uint32_t r = 0; r < Roots.size(); ++r) {
+        Enter(Roots[VisitOrder(Labeling, r, Roots.size())]);
+
+        while (!Frames.empty()) {
+            ComponentID C = Frames.back().first;
+            uint32_t &Next = Frames.back().second;
+            ArrayRef<ComponentID> Succs = DAG.Successors(C);
+            Interval &I = Labels[C * NumLabelings + Labeling];
+
+            if (Next < Succs.size()) {
+                ComponentID D = Succs[VisitOrder(Labeling, Next++, Succs.size())];
+                if (!Seen[D])
+                    Enter(D);
+                else
+                    I.Low = std::min(I.Low, Labels[D * NumLabelings + Labeling].Low);
+                continue;
+            }
+
+            I.Post = NextPost++;
+            I.Low = std::min(I.Low, I.Post);
+            Frames.pop_back();
+            if (!Frames.empty()) {
+                Interval &Parent = Labels[Frames.back().first * NumLabelings + Labeling];
+                Parent.Low = std::min(Parent.Low, I.Low);
+            }
+        }
+    }
+}
+
+// False if some labeling proves V unreachable from U
+bool ReachabilityIndex::MayReach(ComponentID U, ComponentID V) const {
+    const Interval *A = &Labels[U * NumLabelings];
+    const Interval *B = &Labels[V * NumLabelings];
+    for (unsigned L = 0; L < NumLabelings; ++L) {
+        if (B[L].Low < A[L].Low || B[L].Post > A[L].Post)
+            return false;
+    }
+    return true;
+}
+
+// True if V was finished inside the visit of U in labeling 0, i.e. U reaches
+// V along DFS tree edges
+bool ReachabilityIndex::InTree(ComponentID U, ComponentID V) const {
+    uint32_t Post = Labels[V * NumLabelings].Post;
+    return TreeStart[U] <= Post && Post <= Labels[U * NumLabelings].Post;
+}
+
+bool ReachabilityIndex::Reaches(FunctionID From, FunctionID To) {
+    ++Queries;
+    ComponentID U = DAG.Component(From);
+    ComponentID V = DAG.Component(To);
+
+    if (U == V)
+        return true;
+    if (U > V || !MayReach(U, V))
+        return false;
+    if (InTree(U, V))
+        return true;
+
+    ++Searches;
+    return Search(U, V);
+}
+
+bool ReachabilityIndex::Search(ComponentID From, ComponentID To) {
+    if (++Stamp == 0) {
+        // Wrapped around; old stamps could alias the new ones
+        std::fill(Visited.begin(), Visited.end(), 0);
+        Stamp = 1;
+    }
+
+    Worklist.assign(1, From);
+    Visited[From] = Stamp;
+    while (!Worklist.empty()) {
+        ComponentID C = Worklist.back();
+        Worklist.pop_back();
+
+        for (ComponentID D : DAG.Successors(C)) {
+            if (D == To)
+                return true;
+            // Components after To cannot lead back to it
+            if (Visited[D] == Stamp || D > To || !MayReach(D, To))
+                continue;
+            if (InTree(D, To))
+                return true;
+            Visited[D] = Stamp;
+            Worklist.push_back(D);
+        }
+    }
+    return false;
+}
+
+size_t ReachabilityIndex::MemoryUsage() const {
+    return DAG.MemoryUsage() + Labels.size() * sizeof(Interval) + TreeStart.size() * sizeof(uint32_t);
+}
+
+bool RunReachQueries(ReachabilityIndex &Index, const CompactCallGraph &Graph, StringRef Path,
+                     raw_ostream &OS, std::string &Error) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer = MemoryBuffer::getFileOrSTDIN(Path);
+    if (!Buffer) {
+        Error = Buffer.getError().message();
+        return false;
+    }
+
+    StringRef Rest = (*Buffer)->getBuffer();
+    while (!Rest.empty()) {
+        StringRef Line;
+        std::tie(Line, Rest) = Rest.split('\n');
+
+        // Blank lines and # comments are skipped
+        std::pair<StringRef, StringRef> From = getToken(Line);
+        if (From.first.empty() || From.first.startswith("#"))
+            continue;
+        StringRef To = getToken(From.second).first;
+
+        FunctionID Source = Graph.Find(From.first);
+        FunctionID Sink = Graph.Find(To);
+        OS << From.first << ' ' << To << ' ';
+        if (Source == InvalidFunction || Sink == InvalidFunction)
+            OS << "unknown\n";
+        else
+            OS << (Index.Reaches(Source, Sink) ? "yes" : "no") << '\n';
+    }
+    return true;
+}
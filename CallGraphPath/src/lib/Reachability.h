@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Condensation.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ReachabilityIndex: Answers "can From reach To" over a CompactCallGraph
+// without a traversal in most cases. Queries work on the condensation, so
+// functions of one cycle share an answer, and are settled in this order:
+//  - same component: reachable
+//  - To's component before From's in topological order: unreachable
+//  - To outside From's interval in any of NumLabelings DFS post-order
+//    labelings (GRAIL): unreachable
+//  - To inside From's subtree of the first DFS tree: reachable
+//  - otherwise a DFS over the condensation, pruned with the same tests
+// The labels take (2 * NumLabelings + 1) words per component.
+class ReachabilityIndex {
+    public:
+        // NumThreads is passed on to CondensedCallGraph::Build()
+        void Build(const CompactCallGraph &Graph, unsigned NumThreads = 1);
+
+        // True if there is a call path from From to To; a function reaches
+        // itself. Not thread safe: the fallback search reuses scratch arrays.
+        bool Reaches(FunctionID From, FunctionID To);
+
+        const CondensedCallGraph &getCondensation() const { return DAG; }
+        // Memory held by the condensation and the labels, in bytes
+        size_t MemoryUsage() const;
+
+        uint64_t NumQueries() const { return Queries; }
+        // Queries that needed the fallback search
+        uint64_t NumSearches() const { return Searches; }
+
+    private:
+        static const unsigned NumLabelings = 3;
+
+        // Interval of a component in one labeling: every component it reaches
+        // has its post-order number in [Low, Post]
+        struct Interval {
+            uint32_t Low;
+            uint32_t Post;
+        };
+
+        void Label(unsigned Labeling, ArrayRef<ComponentID> Roots);
+        bool MayReach(ComponentID U, ComponentID V) const;
+        bool InTree(ComponentID U, ComponentID V) const;
+        bool Search(ComponentID From, ComponentID To);
+
+        CondensedCallGraph DAG;
+        // NumLabelings intervals per component, component by component
+        std::vector<Interval> Labels;
+        // First post-order number of the DFS subtree of each component in
+        // labeling 0
+        std::vector<uint32_t> TreeStart;
+
+        // Scratch state of Search()
+        std::vector<uint32_t> Visited;
+        uint32_t Stamp = 0;
+        std::vector<ComponentID> Worklist;
+
+        uint64_t Queries = 0;
+        uint64_t Searches = 0;
+};
+
+// Answer the reachability queries in the file at Path ("-" for stdin), one
+// "from to" pair of function names per line, writing "from to yes|no" lines
+// to OS. A function that is not part of the graph gives "unknown". Returns
+// false and sets Error if the file cannot be read.
+bool RunReachQueries(ReachabilityIndex &Index, const CompactCallGraph &Graph, StringRef Path,
+                     raw_ostream &OS, std::string &Error);
@@ -0,0 +1,205 @@
+#include "Stats.h"
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+
+#include <sys/resource.h>
+
+RunStats Stats;
+
+static const char *CounterNames[NumStatCounters] = {
+    "instructions_visited",
+    "edges_recorded",
+    "duplicate_edges_skipped",
+    "settings_recorded",
+    "fp_calls_recorded",
+    "indirect_calls_resolved",
+    "indirect_calls_unresolved",
+    "cache_hits",
+    "cache_misses",
+    "graph_functions",
+    "graph_edges",
+    "cycles",
+    "functions_in_cycles",
+    "reach_components",
+    "reach_index_bytes",
+    "reach_queries",
+    "reach_queries_searched",
+};
+
+RunStats::RunStats() : Start(StatClock::now()) {
+    for (auto &Counter : Counters)
+        Counter.store(0, std::memory_order_relaxed);
+}
+
+void RunStats::Reset() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Start = StatClock::now();
+    for (auto &Counter : Counters)
+        Counter.store(0, std::memory_order_relaxed);
+    Modules.clear();
+    Events.clear();
+}
+
+void RunStats::AddModule(const ModuleStats &MS) {
+    Add(StatInstructions, MS.Instructions);
+    Add(StatEdgesRecorded, MS.Edges);
+    Add(StatSettingsRecorded, MS.Settings);
+    Add(StatFPCallsRecorded, MS.FPCalls);
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    Modules.push_back(MS);
+}
+
+void RunStats::AddEvent(StringRef Name, StringRef Detail,
+                        StatClock::time_point Begin, StatClock::time_point End) {
+    using namespace std::chrono;
+    Event E{Name.str(), Detail.str(),
+            duration_cast<microseconds>(Begin - Start).count(),
+            duration_cast<microseconds>(End - Begin).count(),
+            get_threadid()};
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    Events.push_back(std::move(E));
+}
+
+std::vector<RunStats::PhaseTotal> RunStats::Phases() const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return PhasesLocked();
+}
+
+std::vector<RunStats::PhaseTotal> RunStats::PhasesLocked() const {
+    std::vector<PhaseTotal> Totals;
+    std::map<StringRef, size_t> Index;
+    for (const Event &E : Events) {
+        auto Inserted = Index.insert({E.Name, Totals.size()});
+        if (Inserted.second)
+            Totals.push_back({E.Name, 0, 0});
+        PhaseTotal &Phase = Totals[Inserted.first->second];
+        Phase.Ms += E.DurationUs / 1000.0;
+        Phase.Count += 1;
+    }
+    return Totals;
+}
+
+uint64_t RunStats::PeakRSS() {
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+        return 0;
+    return Usage.ru_maxrss;     // Kilobytes on Linux
+}
+
+static bool OpenOutput(StringRef Path, std::unique_ptr<raw_fd_ostream> &OS, std::string &Error) {
+    std::error_code EC;
+    OS.reset(new raw_fd_ostream(Path, EC, sys::fs::OF_Text));
+    if (EC) {
+        Error = EC.message();
+        return false;
+    }
+    return true;
+}
+
+static bool CloseOutput(raw_fd_ostream &OS, std::string &Error) {
+    OS.close();
+    if (OS.has_error()) {
+        Error = OS.error().message();
+        OS.clear_error();
+        return false;
+    }
+    return true;
+}
+
+bool RunStats::WriteReport(StringRef Path, std::string &Error) const {
+    std::unique_ptr<raw_fd_ostream> OS;
+    if (!OpenOutput(Path, OS, Error))
+        return false;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    // Phases are aggregated by name; per-module detail is in "modules"
+    std::vector<PhaseTotal> Phases = PhasesLocked();
+
+    // Modules in input order; module names are interned in input order
+    std::vector<ModuleStats> SortedModules(Modules);
+    std::sort(SortedModules.begin(), SortedModules.end(),
+              [](const ModuleStats &L, const ModuleStats &R) { return L.Module < R.Module; });
+
+    json::OStream J(*OS, 2);
+    J.object([&] {
+        J.attribute("version", 1);
+        J.attribute("wall_ms", std::chrono::duration<double, std::milli>(StatClock::now() - Start).count());
+        J.attribute("peak_rss_kb", (int64_t)PeakRSS());
+
+        J.attributeObject("counters", [&] {
+            for (unsigned C = 0; C < NumStatCounters; ++C)
+                J.attribute(CounterNames[C], (int64_t)Get((StatCounter)C));
+        });
+
+        J.attributeArray("phases", [&] {
+            for (const PhaseTotal &Phase : Phases) {
+                J.object([&] {
+                    J.attribute("name", Phase.Name);
+                    J.attribute("ms", Phase.Ms);
+                    J.attribute("count", (int64_t)Phase.Count);
+                });
+            }
+        });
+
+        J.attributeArray("modules", [&] {
+            for (const ModuleStats &MS : SortedModules) {
+                J.object([&] {
+                    J.attribute("name", SymbolName(MS.Module));
+                    J.attribute("collect_ms", MS.CollectMs);
+                    J.attribute("instructions", (int64_t)MS.Instructions);
+                    J.attribute("edges", (int64_t)MS.Edges);
+                    J.attribute("settings", (int64_t)MS.Settings);
+                    J.attribute("fp_calls", (int64_t)MS.FPCalls);
+                });
+            }
+        });
+    });
+    *OS << "\n";
+
+    return CloseOutput(*OS, Error);
+}
+
+bool RunStats::WriteTrace(StringRef Path, std::string &Error) const {
+    std::unique_ptr<raw_fd_ostream> OS;
+    if (!OpenOutput(Path, OS, Error))
+        return false;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    // Thread IDs are remapped to small numbers so the viewer shows 0..N-1
+    std::map<uint64_t, unsigned> Threads;
+    for (const Event &E : Events)
+        Threads.insert({E.Thread, (unsigned)Threads.size()});
+
+    json::OStream J(*OS);
+    J.object([&] {
+        J.attribute("displayTimeUnit", "ms");
+        J.attributeArray("traceEvents", [&] {
+            for (const Event &E : Events) {
+                J.object([&] {
+                    J.attribute("name", E.Name);
+                    J.attribute("cat", E.Detail.empty() ? "phase" : "module");
+                    J.attribute("ph", "X");
+                    J.attribute("ts", E.BeginUs);
+                    J.attribute("dur", E.DurationUs);
+                    J.attribute("pid", 1);
+                    J.attribute("tid", (int64_t)Threads[E.Thread]);
+                    if (!E.Detail.empty())
+                        J.attributeObject("args", [&] { J.attribute("module", E.Detail); });
+                });
+            }
+        });
+    });
+    *OS << "\n";
+
+    return CloseOutput(*OS, Error);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "SymbolTable.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using StatClock = std::chrono::steady_clock;
+
+// Run-wide counters
+enum StatCounter : unsigned {
+    StatInstructions,          // Instructions visited by the collectors
+    StatEdgesRecorded,         // Call edges recorded, direct and indirect
+    StatEdgesDeduplicated,     // Calls dropped or merged as repeats of a recorded edge
+    StatSettingsRecorded,      // Function pointer settings recorded
+    StatFPCallsRecorded,       // Functions passed as call arguments
+    StatIndirectResolved,      // Indirect calls attributed to a target
+    StatIndirectUnresolved,    // Indirect calls left without a target
+    StatCacheHits,
+    StatCacheMisses,
+    StatGraphFunctions,        // Nodes of the compact call graph
+    StatGraphEdges,            // Edges of the compact call graph
+    StatCycles,                // Call cycles (non-trivial strongly connected components)
+    StatCycleFunctions,        // Functions on call cycles
+    StatReachComponents,       // Strongly connected components in the reachability index
+    StatReachIndexBytes,       // Memory held by the reachability index
+    StatReachQueries,          // Reachability queries answered
+    StatReachSearches,         // Reachability queries the labels could not settle
+    NumStatCounters
+};
+
+// ModuleStats: What collecting a single module cost and produced
+struct ModuleStats {
+    SymbolID Module;
+    double CollectMs;
+    uint64_t Instructions;
+    uint64_t Edges;
+    uint64_t Settings;
+    uint64_t FPCalls;
+};
+
+// RunStats: Timings and counters of a run, written as a JSON report and as a
+// Chrome trace-event file (load it in chrome://tracing or Perfetto).
+// Everything is recorded at phase or module granularity, so the hot
+// collection loops are not touched. All members may be called concurrently.
+class RunStats {
+    public:
+        // Total time of the events of one name, in order of first appearance
+        struct PhaseTotal {
+            std::string Name;
+            double Ms;
+            unsigned Count;
+        };
+
+        RunStats();
+
+        void Add(StatCounter Counter, uint64_t N = 1) {
+            Counters[Counter].fetch_add(N, std::memory_order_relaxed);
+        }
+        uint64_t Get(StatCounter Counter) const {
+            return Counters[Counter].load(std::memory_order_relaxed);
+        }
+
+        // Record a module and add its numbers to the run-wide counters
+        void AddModule(const ModuleStats &MS);
+
+        // Record a finished phase. Detail (e.g. the module) is shown in the trace.
+        void AddEvent(StringRef Name, StringRef Detail, StatClock::time_point Begin, StatClock::time_point End);
+
+        std::vector<PhaseTotal> Phases() const;
+
+        // Forget everything recorded so far, e.g. between benchmark runs
+        void Reset();
+
+        bool WriteReport(StringRef Path, std::string &Error) const;
+        bool WriteTrace(StringRef Path, std::string &Error) const;
+
+        // Peak resident set size of the process, in kilobytes
+        static uint64_t PeakRSS();
+
+    private:
+        struct Event {
+            std::string Name;
+            std::string Detail;
+            int64_t BeginUs;
+            int64_t DurationUs;
+            uint64_t Thread;
+        };
+
+        std::vector<PhaseTotal> PhasesLocked() const;
+
+        StatClock::time_point Start;
+        std::atomic<uint64_t> Counters[NumStatCounters];
+
+        mutable std::mutex Lock;
+        std::vector<ModuleStats> Modules;
+        std::vector<Event> Events;
+};
+
+// The process-wide statistics
+extern RunStats Stats;
+
+// ScopedTimer: Records the lifetime of the timer as a phase
+class ScopedTimer {
+    public:
+        explicit ScopedTimer(StringRef Name, StringRef Detail = StringRef())
+            : Name(Name), Detail(Detail), Begin(StatClock::now()) {}
+        ~ScopedTimer() { Stats.AddEvent(Name, Detail, Begin, StatClock::now()); }
+
+        double ElapsedMs() const {
+            return std::chrono::duration<double, std::milli>(StatClock::now() - Begin).count();
+        }
+
+    private:
+        StringRef Name;
+        StringRef Detail;
+        StatClock::time_point Begin;
+};
@@ -0,0 +1,51 @@
+#include "SymbolTable.h"
+
+SymbolTable Symbols;
+thread_local SymbolTable *ThreadSymbols = nullptr;
+
+SymbolTable::SymbolTable() : Size(0) {
+    for (auto &Chunk : Chunks)
+        Chunk.store(nullptr, std::memory_order_relaxed);
+
+    Intern("");
+    Intern("indirect");
+    Intern("global");
+}
+
+SymbolTable::~SymbolTable() {
+    for (auto &Chunk : Chunks)
+        delete[] Chunk.load(std::memory_order_relaxed);
+}
+
+SymbolID SymbolTable::Intern(StringRef Name) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return InternLocked(Name);
+}
+
+SymbolID SymbolTable::InternLocked(StringRef Name) {
+    SymbolID ID = Size.load(std::memory_order_relaxed);
+    auto Inserted = IDs.try_emplace(Name, ID);
+    if (!Inserted.second)
+        return Inserted.first->getValue();
+
+    uint64_t Slot = (uint64_t)ID + FirstChunkSize;
+    unsigned Chunk = Log2_64(Slot) - FirstChunkBits;
+    StringRef *Names = Chunks[Chunk].load(std::memory_order_relaxed);
+    if (!Names) {
+        Names = new StringRef[FirstChunkSize << Chunk];
+        Chunks[Chunk].store(Names, std::memory_order_release);
+    }
+    Names[Slot - (FirstChunkSize << Chunk)] = Inserted.first->getKey();
+    Size.store(ID + 1, std::memory_order_release);
+
+    return ID;
+}
+
+void SymbolTable::Import(const SymbolTable &Other, std::vector<SymbolID> &Map) {
+    size_t Count = Other.size();
+    Map.resize(Count);
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    for (size_t ID = 0; ID < Count; ++ID)
+        Map[ID] = InternLocked(Other.Name(ID));
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+
+// SymbolID: Index of an interned module, function, variable or type name.
+using SymbolID = uint32_t;
+
+// Symbols interned when the table is created
+const SymbolID EmptySymbol = 0;      // ""
+const SymbolID IndirectSymbol = 1;   // "indirect", callee of an unresolved indirect call
+const SymbolID GlobalSymbol = 2;     // "global", setter of statically initialized pointers
+
+// SymbolTable: Interns names so that facts store 32-bit IDs instead of
+// std::string copies and compare names with a single integer compare.
+// Each distinct name is stored once, in a bump allocator owned by the table.
+// Intern() may be called concurrently. Name() takes no lock: names are kept
+// in chunks that never move, so any thread holding an ID can look it up.
+class SymbolTable {
+    public:
+        SymbolTable();
+        ~SymbolTable();
+        SymbolTable(const SymbolTable &) = delete;
+        SymbolTable &operator=(const SymbolTable &) = delete;
+
+        SymbolID Intern(StringRef Name);
+        StringRef Name(SymbolID ID) const {
+            uint64_t Slot = (uint64_t)ID + FirstChunkSize;
+            unsigned Chunk = Log2_64(Slot) - FirstChunkBits;
+            return Chunks[Chunk].load(std::memory_order_acquire)[Slot - (FirstChunkSize << Chunk)];
+        }
+        size_t size() const { return Size.load(std::memory_order_acquire); }
+
+        // Intern every name of Other in ID order, so Map[ID in Other] is the
+        // name's ID here
+        void Import(const SymbolTable &Other, std::vector<SymbolID> &Map);
+
+    private:
+        // Chunk k holds FirstChunkSize << k names, so 33 - FirstChunkBits
+        // chunks cover every 32-bit ID
+        static const unsigned FirstChunkBits = 10;
+        static const uint64_t FirstChunkSize = 1u << FirstChunkBits;
+        static const unsigned NumChunks = 33 - FirstChunkBits;
+
+        SymbolID InternLocked(StringRef Name);
+
+        std::mutex Lock;
+        StringMap<SymbolID, BumpPtrAllocator> IDs;
+        // The keys stored in IDs, by ID. A name is written before size()
+        // counts it.
+        std::atomic<StringRef *> Chunks[NumChunks];
+        std::atomic<size_t> Size;
+};
+
+// The process-wide symbol table
+extern SymbolTable Symbols;
+
+// Table Intern() and SymbolName() use on the calling thread: Symbols, unless
+// a ScopedSymbolTable is active
+extern thread_local SymbolTable *ThreadSymbols;
+
+inline SymbolTable &ActiveSymbols() {
+    return ThreadSymbols ? *ThreadSymbols : Symbols;
+}
+
+// ScopedSymbolTable: Interns into Table on this thread while in scope. A
+// module collected on a worker interns into a table of its own, so workers
+// do not contend for Symbols and IDs do not depend on which worker gets to a
+// name first; its symbols are mapped to global IDs when it is merged.
+class ScopedSymbolTable {
+    public:
+        explicit ScopedSymbolTable(SymbolTable &Table) : Saved(ThreadSymbols) { ThreadSymbols = &Table; }
+        ~ScopedSymbolTable() { ThreadSymbols = Saved; }
+
+    private:
+        SymbolTable *Saved;
+};
+
+inline SymbolID Intern(StringRef Name) {
+    return ActiveSymbols().Intern(Name);
+}
+
+inline StringRef SymbolName(SymbolID ID) {
+    return ActiveSymbols().Name(ID);
+}
+
+// Pack two symbols into one 64-bit key
+inline uint64_t PackSymbols(SymbolID Hi, SymbolID Lo) {
+    return (uint64_t)Hi << 32 | Lo;
+}
+
+// Key of FunctionPointerSettings: module in the high 32 bits, line in the low 32
+inline uint64_t MakeLineKey(SymbolID ModName, unsigned Line) {
+    return (uint64_t)ModName << 32 | Line;
+}
+
+// Key of FunctionPointerCallMap: module, then 24 bits
+// of line and 8 bits of argument index. The key only groups entries; the
+// exact line and index are kept in the stored info.
+inline uint64_t MakeArgKey(SymbolID ModName, unsigned Line, unsigned ArgIndex) {
+    return (uint64_t)ModName << 32 | (uint64_t)(Line & 0xffffff) << 8 | std::min(ArgIndex, 0xffu);
+}
+
+inline SymbolID KeyModule(uint64_t Key) { return Key >> 32; }
+inline unsigned LineKeyLine(uint64_t Key) { return (uint32_t)Key; }
+inline unsigned ArgKeyLine(uint64_t Key) { return (Key >> 8) & 0xffffff; }
+inline unsigned ArgKeyArgIndex(uint64_t Key) { return Key & 0xff; }
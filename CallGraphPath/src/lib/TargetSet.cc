@@ -0,0 +1,110 @@
+#include "TargetSet.h"
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+TargetPool SpilledTargets;
+
+// Hash index slots of an indexed block of Capacity targets, at most half full
+static uint32_t IndexSize(uint32_t Capacity) {
+    return PowerOf2Ceil((uint64_t)Capacity * 2);
+}
+
+// A block for Capacity targets followed by their index, if they need one
+static SymbolID *AllocateBlock(uint32_t Capacity, bool Indexed) {
+    return SpilledTargets.Allocate(Capacity + (Indexed ? IndexSize(Capacity) : 0));
+}
+
+SymbolID *TargetPool::Allocate(uint32_t Size) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Allocator.Allocate<SymbolID>(Size);
+}
+
+size_t TargetPool::BytesAllocated() const {
+    std::lock_guard<std::mutex> Guard(Lock);
+    return Allocator.getTotalMemory();
+}
+
+TargetSet::TargetSet(const TargetSet &Other) : Size(0), Capacity(InlineCapacity) {
+    *this = Other;
+}
+
+TargetSet::TargetSet(TargetSet &&Other) : Size(0), Capacity(InlineCapacity) {
+    *this = std::move(Other);
+}
+
+TargetSet &TargetSet::operator=(TargetSet &&Other) {
+    if (this == &Other || !Other.isSpilled())
+        return *this = (const TargetSet &)Other;
+
+    // The block of this set, if any, stays in the pool unused
+    Spilled = Other.Spilled;
+    Size = Other.Size;
+    Capacity = Other.Capacity;
+    Other.Size = 0;
+    Other.Capacity = InlineCapacity;
+    return *this;
+}
+
+TargetSet &TargetSet::operator=(const TargetSet &Other) {
+    if (this == &Other)
+        return *this;
+
+    // Copy a spilled set into a block of its own, sized to fit
+    if (Other.Size > Capacity) {
+        Spilled = AllocateBlock(Other.Size, Other.Size > IndexThreshold);
+        Capacity = Other.Size;
+    }
+    std::copy(Other.begin(), Other.end(), data());
+    Size = Other.Size;
+    if (isIndexed())
+        RebuildIndex();
+    return *this;
+}
+
+bool TargetSet::Insert(SymbolID Target) {
+    if (isIndexed() ? *FindSlot(Target) != 0 : std::find(begin(), end(), Target) != end())
+        return false;
+
+    if (Size == Capacity)
+        Grow(Capacity * 2);
+
+    data()[Size++] = Target;
+    if (isIndexed())
+        *FindSlot(Target) = Size;
+    return true;
+}
+
+void TargetSet::Remap(ArrayRef<SymbolID> Map) {
+    SymbolID *Targets = data();
+    for (uint32_t i = 0; i < Size; ++i)
+        Targets[i] = Map[Targets[i]];
+    if (isIndexed())
+        RebuildIndex();
+}
+
+void TargetSet::Grow(uint32_t NewCapacity) {
+    SymbolID *Grown = AllocateBlock(NewCapacity, NewCapacity > IndexThreshold);
+    std::copy(begin(), end(), Grown);
+    Spilled = Grown;
+    Capacity = NewCapacity;
+    if (isIndexed())
+        RebuildIndex();
+}
+
+uint32_t *TargetSet::FindSlot(SymbolID Target) {
+    uint32_t *Index = Spilled + Capacity;
+    uint32_t Mask = IndexSize(Capacity) - 1;
+    for (uint32_t i = DenseMapInfo<SymbolID>::getHashValue(Target) & Mask;; i = (i + 1) & Mask) {
+        if (!Index[i] || Spilled[Index[i] - 1] == Target)
+            return &Index[i];
+    }
+}
+
+void TargetSet::RebuildIndex() {
+    std::fill(Spilled + Capacity, Spilled + Capacity + IndexSize(Capacity), 0);
+    for (uint32_t i = 0; i < Size; ++i)
+        *FindSlot(Spilled[i]) = i + 1;
+}
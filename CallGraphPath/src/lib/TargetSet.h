@@ -0,0 +1,85 @@
+#pragma once
+
+#include "SymbolTable.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include <cstdint>
+#include <mutex>
+
+using namespace llvm;
+
+// TargetPool: Shared storage for the TargetSets that outgrow their inline
+// slots. Blocks are bump allocated and never move or get freed one by one,
+// so a set grows by copying into a block twice the size. Allocate() may be
+// called concurrently.
+class TargetPool {
+    public:
+        SymbolID *Allocate(uint32_t Size);
+        // Bytes taken from the system so far
+        size_t BytesAllocated() const;
+
+    private:
+        mutable std::mutex Lock;
+        BumpPtrAllocator Allocator;
+};
+
+// The process-wide pool
+extern TargetPool SpilledTargets;
+
+// TargetSet: The functions an edge may call, without duplicates and in
+// insertion order. Up to two targets, by far the common case, are stored
+// inline; larger sets spill to SpilledTargets. Copies do not share storage;
+// moving a set hands its spilled block over.
+//
+// Small sets find duplicates by a linear scan. Past IndexThreshold targets
+// the spilled block also holds an open-addressing hash index of the targets,
+// so filling a set with thousands of targets stays linear.
+class TargetSet {
+    public:
+        TargetSet() : Size(0), Capacity(InlineCapacity) { }
+        TargetSet(const TargetSet &Other);
+        TargetSet(TargetSet &&Other);
+        TargetSet &operator=(const TargetSet &Other);
+        TargetSet &operator=(TargetSet &&Other);
+
+        // Add Target unless the set has it already. Returns true if added.
+        bool Insert(SymbolID Target);
+        void Insert(ArrayRef<SymbolID> Targets) {
+            for (SymbolID Target : Targets)
+                Insert(Target);
+        }
+        // Replace every target T by Map[T]. Map must not send two targets to
+        // the same ID.
+        void Remap(ArrayRef<SymbolID> Map);
+
+        ArrayRef<SymbolID> targets() const { return ArrayRef<SymbolID>(data(), Size); }
+        const SymbolID *begin() const { return data(); }
+        const SymbolID *end() const { return data() + Size; }
+        uint32_t size() const { return Size; }
+        bool empty() const { return Size == 0; }
+        SymbolID front() const { return data()[0]; }
+
+    private:
+        static const uint32_t InlineCapacity = 2;
+        static const uint32_t IndexThreshold = 16;
+
+        bool isSpilled() const { return Capacity > InlineCapacity; }
+        bool isIndexed() const { return Capacity > IndexThreshold; }
+        // Move the targets to a block of NewCapacity, indexed if large enough
+        void Grow(uint32_t NewCapacity);
+        // Index slot holding Target, or the empty slot it would go to. Slots
+        // follow the targets in the block and hold a position + 1 (0 = empty).
+        uint32_t *FindSlot(SymbolID Target);
+        void RebuildIndex();
+        SymbolID *data() { return isSpilled() ? Spilled : Inline; }
+        const SymbolID *data() const { return isSpilled() ? Spilled : Inline; }
+
+        uint32_t Size;
+        uint32_t Capacity;
+        union {
+            SymbolID Inline[InlineCapacity];
+            SymbolID *Spilled;
+        };
+};
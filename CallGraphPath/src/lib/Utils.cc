@@ -1,98 +1,118 @@
 #include "Utils.h"
+#include "Logger.h"
+
 #include <iostream>
 
 void PrintModuleFunctionMap(const ModuleFunctionMap &ModuleFunctionMap, const std::string &ModName) {
+    if (!LogEnabled(LogLevel::Debug, LogDump))
+        return;
+
+    LogBlock Log;
+    raw_ostream &OS = Log.stream();
+
     // Debugging log to confirm the collected function prototypes for the specific module
     if (ModuleFunctionMap.find(ModName) != ModuleFunctionMap.end()) {
         for (const auto &funcEntry : ModuleFunctionMap.at(ModName)) {
-            errs() << "[debug] Collected function prototypes for module: " << ModName << "\n";
-            errs() << "Function: " << funcEntry.first << "\n";
+            OS << "[debug] Collected function prototypes for module: " << ModName << "\n";
+            OS << "Function: " << funcEntry.first << "\n";
             for (const auto &proto : funcEntry.second) {
-                errs() << "  Return Type: " << std::get<0>(proto) << "\n";
-                errs() << "  Arguments: ";
+                OS << "  Return Type: " << std::get<0>(proto) << "\n";
+                OS << "  Arguments: ";
                 for (const auto &arg : std::get<1>(proto)) {
-                    errs() << arg << " ";
+                    OS << arg << " ";
                 }
-                errs() << "\n  Line: " << std::get<2>(proto) << "\n";
+                OS << "\n  Line: " << std::get<2>(proto) << "\n";
             }
         }
     } else {
-        errs() << "[debug] No function prototypes found for module: " << ModName << "\n";
+        OS << "[debug] No function prototypes found for module: " << ModName << "\n";
     }
 }
 
 // // Function to print the collected function pointer settings for a given module
 // Example of logging the contents of FunctionPointerSettings
 void PrintFunctionPointerSettings(const FunctionPointerSettings &settings) {
-    errs() << "==== Dump FunctionPointerSettings data ====\n";
-    for (const auto &entry : settings) {
-        const std::string &key = entry.first;  // Key is the module name + line number
-        const std::vector<FunctionPointerSettingInfo> &functionSettings = entry.second;
+    if (!LogEnabled(LogLevel::Debug, LogDump))
+        return;
+
+    LogBlock Log;
+    raw_ostream &OS = Log.stream();
 
-        errs() << "[debug] Function pointer settings for " << key << ":\n";
+    OS << "==== Dump FunctionPointerSettings data ====\n";
+    for (const auto &group : settings) {
+        uint64_t key = group.Key;  // Key is the module name + line number
+
+        OS << "[debug] Function pointer settings for " << SymbolName(KeyModule(key))
+               << ":" << LineKeyLine(key) << ":\n";
         
         // Iterate through each setting in the vector
-        for (const auto &setting : functionSettings) {
-            errs() << "  Function pointer variable: " << setting.SetterName << "\n";
-            errs() << "  Struct type (if applicable): " << setting.StructTypeName << "\n";
-            errs() << "  Function name: " << setting.FuncName << "\n";
-            errs() << "  Line: " << setting.Line << "\n";
-            errs() << "  Offset: " << setting.Offset << "\n";
+        for (const auto &setting : group) {
+            OS << "  Function pointer variable: " << SymbolName(setting.SetterName) << "\n";
+            OS << "  Struct type (if applicable): " << SymbolName(setting.StructTypeName) << "\n";
+            OS << "  Function name: " << SymbolName(setting.FuncName) << "\n";
+            OS << "  Line: " << setting.Line << "\n";
+            OS << "  Offset: " << setting.Offset << "\n";
         }
     }
-    errs() << "==== Dump FunctionPointerSettings data end ====\n";
+    OS << "==== Dump FunctionPointerSettings data end ====\n";
 }
 
 void PrintFunctionPointerCallMap(const FunctionPointerCallMap &CallMap) {
-    errs() << "==== Dump FunctionPointerCallMap data ====\n";
+    if (!LogEnabled(LogLevel::Debug, LogDump))
+        return;
 
-    for (const auto &entry : CallMap) {
-        const std::string &key = entry.first;
-        const std::vector<FunctionPointerCallInfo> &calls = entry.second;
+    LogBlock Log;
+    raw_ostream &OS = Log.stream();
 
-        errs() << "[debug] Function pointer calls for " << key << ":\n";
-        for (const auto &info : calls) {
-            errs() << "  Module: " << info.ModName << "\n"
-                   << "  Caller function: " << info.CallerFuncName << "\n"
-                   << "  Callee function: " << info.CalleeFuncName << "\n"
-                   << "  Line: " << info.Line << "\n"
-                   << "  Argument index: " << info.ArgIndex << "\n";
-        }
-    }
+    OS << "==== Dump FunctionPointerCallMap data ====\n";
 
-    errs() << "==== Dump FunctionPointerCallMap data end ====\n";
-}
+    for (const auto &group : CallMap) {
+        uint64_t key = group.Key;
 
-void PrintFunctionPointerUseMap(const FunctionPointerUseMap &UseMap) {
-    errs() << "==== Dump FunctionPointerUseMap data ====\n";
-    for (const auto &entry : UseMap) {
-        errs() << "[debug] Function pointer uses for " << entry.first << ":\n";
-        for (const auto &info : entry.second) {
-            errs() << "  Module: " << info.ModName << "\n"
-                   << "  Caller function: " << info.CallerFuncName << "\n"
-                   << "  Callee function: " << info.CalleeFuncName << "\n"
+        OS << "[debug] Function pointer calls for " << SymbolName(KeyModule(key))
+               << ":" << ArgKeyLine(key) << ":" << ArgKeyArgIndex(key) << ":\n";
+        for (const auto &info : group) {
+            OS << "  Module: " << SymbolName(info.ModName) << "\n"
+                   << "  Caller function: " << SymbolName(info.CallerFuncName) << "\n"
+                   << "  Callee function: " << SymbolName(info.CalleeFuncName) << "\n"
                    << "  Line: " << info.Line << "\n"
                    << "  Argument index: " << info.ArgIndex << "\n";
         }
     }
-    errs() << "==== Dump FunctionPointerUseMap data end ====\n";
+
+    OS << "==== Dump FunctionPointerCallMap data end ====\n";
 }
 
+// The call graph is the result of a run, so it is printed whatever the log
+// level; only the dumps of the intermediate facts above are debug output
 void PrintCallGraph(const ModuleCallGraph &CallGraph) {
-    errs() << "==== Dump CallGraph data ====\n";
-
-    for (const auto &entry : CallGraph) {
-        const std::string &ModName = entry.first;
-        const std::vector<CallEdgeInfo> &edges = entry.second;
-
-        errs() << "[debug] Call edges for module: " << ModName << "\n";
-        for (const auto &edge : edges) {
-            errs() << "----------\n" <<  "Caller function: " << edge.CallerFunction << "\n"
-                   << "  Callee function: " << edge.CalleeFunction << "\n"
-                   << "  Line: " << edge.Line << "\n"
-                   << "  Type: " << (edge.IsIndirect ? "indirect" : "direct") << "\n";
+    LogBlock Log;
+    raw_ostream &OS = Log.stream();
+
+    OS << "==== Dump CallGraph data ====\n";
+
+    for (const auto &group : CallGraph) {
+        SymbolID ModName = group.Key;
+
+        OS << "[debug] Call edges for module: " << SymbolName(ModName) << "\n";
+        for (const auto &edge : group) {
+            // One entry per target; an unresolved call shows "indirect" as its callee
+            ArrayRef<SymbolID> Callees = edge.Callees.targets();
+            if (Callees.empty())
+                Callees = IndirectSymbol;
+
+            for (SymbolID Callee : Callees) {
+                OS << "----------\n" <<  "Caller function: " << SymbolName(edge.CallerFunction) << "\n"
+                       << "  Callee function: " << SymbolName(Callee) << "\n"
+                       << "  Line: " << edge.Line << "\n"
+                       << "  Type: " << (edge.IsIndirect ? "indirect" : "direct") << "\n";
+                if (edge.StructTypeName != EmptySymbol)
+                    OS << "  Struct field: " << SymbolName(edge.StructTypeName) << ":" << edge.Offset << "\n";
+                if (edge.TypeMatched)
+                    OS << "  Matched by signature: " << SymbolName(edge.Signature) << "\n";
+            }
         }
     }
 
-    errs() << "==== Dump CallGraph data end ====\n";
+    OS << "==== Dump CallGraph data end ====\n";
 }
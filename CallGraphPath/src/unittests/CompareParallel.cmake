@@ -0,0 +1,60 @@
+# Run kanalyzer on the modules parallel-fixture writes, serially and then
+# RUNS times with THREADS threads, and require the exported call graph and
+# the saved graph file to be byte-identical every time.
+#
+# cmake -DFIXTURE=<path> -DKANALYZER=<path> -DWORK_DIR=<dir>
+#       [-DTHREADS=4] [-DRUNS=3] -P CompareParallel.cmake
+
+if(NOT THREADS)
+    set(THREADS 4)
+endif()
+if(NOT RUNS)
+    set(RUNS 3)
+endif()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(
+    COMMAND ${FIXTURE} ${WORK_DIR}
+    OUTPUT_VARIABLE Modules
+    RESULT_VARIABLE Result)
+if(NOT Result EQUAL 0)
+    message(FATAL_ERROR "parallel-fixture failed")
+endif()
+string(STRIP "${Modules}" Modules)
+string(REPLACE "\n" ";" Modules "${Modules}")
+
+# Run kanalyzer with -j Threads, writing <Name>.txt and <Name>.graph
+function(run_kanalyzer Threads Name)
+    execute_process(
+        COMMAND ${KANALYZER} -j ${Threads} -o ${WORK_DIR}/${Name}.txt -output-format=text
+                -save-graph=${WORK_DIR}/${Name}.graph ${Modules}
+        OUTPUT_FILE ${WORK_DIR}/${Name}.log
+        ERROR_FILE ${WORK_DIR}/${Name}.log
+        RESULT_VARIABLE Result)
+    if(NOT Result EQUAL 0)
+        file(READ ${WORK_DIR}/${Name}.log Log)
+        message(FATAL_ERROR "kanalyzer -j ${Threads} failed:\n${Log}")
+    endif()
+endfunction()
+
+run_kanalyzer(1 serial)
+file(READ ${WORK_DIR}/serial.txt Serial)
+if(Serial STREQUAL "")
+    message(FATAL_ERROR "the serial run exported no edges")
+endif()
+
+foreach(Run RANGE 1 ${RUNS})
+    run_kanalyzer(${THREADS} parallel${Run})
+    foreach(Ext txt graph)
+        execute_process(
+            COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/serial.${Ext} ${WORK_DIR}/parallel${Run}.${Ext}
+            RESULT_VARIABLE Differs)
+        if(Differs)
+            message(FATAL_ERROR "run ${Run} with -j ${THREADS}: parallel${Run}.${Ext} differs from serial.${Ext}")
+        endif()
+    endforeach()
+endforeach()
+
+message(STATUS "${RUNS} run(s) with -j ${THREADS} match the serial run")
@@ -0,0 +1,83 @@
+// condensation-test: Condense random cyclic call graphs larger than the
+// serial threshold with one thread and with several, and check that both
+// give the same numbered DAG and that every call follows its order.
+//
+// usage: condensation-test [seed] [threads]   (default: 1 4)
+
+#include "Condensation.h"
+#include "RandomGraph.h"
+
+#include <cstdlib>
+#include <iostream>
+
+// Returns the number of differences between Serial and Parallel
+static unsigned Compare(const CompactCallGraph &Graph, const CondensedCallGraph &Serial,
+                        const CondensedCallGraph &Parallel) {
+    unsigned Diffs = 0;
+    auto Report = [&Diffs](const std::string &What) {
+        if (++Diffs <= 5)
+            std::cerr << "error: " << What << " differs" << std::endl;
+    };
+
+    if (Serial.NumComponents() != Parallel.NumComponents()) {
+        Report("number of components");
+        return Diffs;
+    }
+    if (Serial.NumEdges() != Parallel.NumEdges() || Serial.NumCycles() != Parallel.NumCycles())
+        Report("number of DAG edges or cycles");
+
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        if (Serial.Component(F) != Parallel.Component(F))
+            Report("component of " + Graph.Name(F).str());
+    }
+    for (ComponentID C = 0; C < Serial.NumComponents(); ++C) {
+        if (Serial.Members(C) != Parallel.Members(C))
+            Report("members of component " + std::to_string(C));
+        if (Serial.Successors(C) != Parallel.Successors(C) ||
+            Serial.SuccessorEdges(C) != Parallel.SuccessorEdges(C))
+            Report("successors of component " + std::to_string(C));
+        if (Serial.IsCycle(C) != Parallel.IsCycle(C))
+            Report("cycle flag of component " + std::to_string(C));
+    }
+
+    // Topological numbering: no call leads to an earlier component
+    for (FunctionID F = 0; F < Graph.NumFunctions(); ++F) {
+        for (FunctionID Callee : Graph.Callees(F)) {
+            if (Serial.Component(Callee) < Serial.Component(F))
+                Report("order of " + Graph.Name(F).str() + " -> " + Graph.Name(Callee).str());
+        }
+    }
+    return Diffs;
+}
+
+int main(int argc, char **argv) {
+    unsigned Seed = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+    unsigned NumThreads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+    if (NumThreads < 2) {
+        std::cerr << "error: threads must be at least 2" << std::endl;
+        return 1;
+    }
+    std::mt19937 Rng(Seed);
+
+    // Mostly small components, one giant cycle, and a mix of both
+    struct Shape {
+        unsigned N, Degree, RingSize;
+    };
+    unsigned Diffs = 0;
+    for (Shape S : {Shape{20000, 1, 0}, Shape{20000, 4, 0}, Shape{30000, 2, 10000}, Shape{60000, 2, 5000}}) {
+        CompactCallGraph Graph;
+        BuildRandomGraph(Rng, S.N, S.Degree, S.RingSize, Graph);
+
+        CondensedCallGraph Serial, Parallel;
+        Serial.Build(Graph, 1);
+        Parallel.Build(Graph, NumThreads);
+
+        unsigned D = Compare(Graph, Serial, Parallel);
+        std::cout << "functions: " << Graph.NumFunctions() << "  calls: " << Graph.NumEdges()
+                  << "  components: " << Serial.NumComponents() << "  cycles: " << Serial.NumCycles()
+                  << "  differences: " << D << std::endl;
+        Diffs += D;
+    }
+
+    return Diffs ? 1 : 0;
+}
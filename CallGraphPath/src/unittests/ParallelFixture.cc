@@ -0,0 +1,150 @@
+// parallel-fixture: Write the modules CompareParallel.cmake runs kanalyzer
+// on, and print their paths in command line order.
+//
+// core.bc comes first and is by far the largest, so with several threads
+// the drivers are collected before it, the reverse of the serial order.
+// Every driver stores its handlers to the struct fields and the global
+// pointer core.bc calls through, and passes one to disp(), so the targets of
+// those calls come from all modules.
+//
+// usage: parallel-fixture <dir>
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <iostream>
+#include <string>
+
+using namespace llvm;
+
+static const unsigned NumFillers = 30000;
+static const unsigned NumDrivers = 6;
+
+static const char *CoreIR = R"(
+%struct.ops = type { void ()*, void (i32)* }
+
+@default_ops = global %struct.ops { void ()* @core_open, void (i32)* @core_close }
+@hook = global void ()* @core_hook
+
+define void @core_open() {
+  ret void
+}
+
+define void @core_close(i32 %x) {
+  ret void
+}
+
+define void @core_hook() {
+  ret void
+}
+
+define void @run_ops(%struct.ops* %o) {
+  %p = getelementptr %struct.ops, %struct.ops* %o, i32 0, i32 0
+  %f = load void ()*, void ()** %p
+  call void %f()
+  %q = getelementptr %struct.ops, %struct.ops* %o, i32 0, i32 1
+  %g = load void (i32)*, void (i32)** %q
+  call void %g(i32 1)
+  ret void
+}
+
+define void @call_hook() {
+  %f = load void ()*, void ()** @hook
+  call void %f()
+  ret void
+}
+
+define void @disp(void ()* %fp) {
+  call void %fp()
+  ret void
+}
+
+define void @core_main() {
+  call void @disp(void ()* @core_open)
+  ret void
+}
+)";
+
+static std::string DriverIR(unsigned i) {
+    std::string D = "drv" + std::to_string(i);
+    return R"(
+%struct.ops = type { void ()*, void (i32)* }
+
+@hook = external global void ()*
+
+declare void @run_ops(%struct.ops*)
+declare void @call_hook()
+declare void @disp(void ()*)
+
+define void @)" + D + R"(_open() {
+  ret void
+}
+
+define void @)" + D + R"(_close(i32 %x) {
+  ret void
+}
+
+define void @)" + D + R"(_init() {
+  %o = alloca %struct.ops
+  %p = getelementptr %struct.ops, %struct.ops* %o, i32 0, i32 0
+  store void ()* @)" + D + R"(_open, void ()** %p
+  %q = getelementptr %struct.ops, %struct.ops* %o, i32 0, i32 1
+  store void (i32)* @)" + D + R"(_close, void (i32)** %q
+  call void @run_ops(%struct.ops* %o)
+  store void ()* @)" + D + R"(_open, void ()** @hook
+  call void @call_hook()
+  call void @disp(void ()* @)" + D + R"(_open)
+  ret void
+}
+)";
+}
+
+// Functions that only make the module take long to collect
+static std::string Fillers(StringRef Prefix, unsigned Count) {
+    std::string IR;
+    for (unsigned i = 0; i < Count; ++i)
+        IR += "define void @" + Prefix.str() + std::to_string(i) + "() {\n  ret void\n}\n";
+    return IR;
+}
+
+static bool Write(StringRef Dir, StringRef Name, const std::string &IR) {
+    std::string Path = (Dir + "/" + Name).str();
+    LLVMContext Context;
+    SMDiagnostic Err;
+    std::unique_ptr<Module> M = parseAssemblyString(IR, Err, Context);
+    if (!M) {
+        Err.print(Name.data(), errs());
+        return false;
+    }
+
+    std::error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+    if (EC) {
+        std::cerr << "error: cannot write " << Path << ": " << EC.message() << std::endl;
+        return false;
+    }
+    WriteBitcodeToFile(*M, OS);
+    std::cout << Path << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "usage: parallel-fixture <dir>" << std::endl;
+        return 1;
+    }
+    StringRef Dir = argv[1];
+
+    if (!Write(Dir, "core.bc", Fillers("core_filler", NumFillers) + CoreIR))
+        return 1;
+    for (unsigned i = 0; i < NumDrivers; ++i) {
+        if (!Write(Dir, "drv" + std::to_string(i) + ".bc", DriverIR(i)))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+// path-query-test: Run PathQuery on small hand-built call graphs and check
+// the paths found: the shortest one, the MaxDepth bound, K simple paths in
+// shortest-first order over parallel edges, an unreachable sink, and a time
+// budget running out on a graph with too many paths to enumerate.
+//
+// usage: path-query-test
+
+#include "PathQuery.h"
+
+#include <iostream>
+#include <sstream>
+
+static unsigned Wrong = 0;
+
+static void Expect(bool Ok, const std::string &What) {
+    if (!Ok) {
+        std::cerr << "error: " << What << std::endl;
+        ++Wrong;
+    }
+}
+
+static std::string Render(const CompactCallGraph &Graph, const CallPath &Path) {
+    std::ostringstream OS;
+    PrintCallPath(Graph, Path, OS);
+    return OS.str();
+}
+
+static void ExpectPath(const CompactCallGraph &Graph, const CallPath &Path, const std::string &Expected) {
+    std::string Found = Render(Graph, Path);
+    Expect(Found == Expected, "found " + Found + ", expected " + Expected);
+}
+
+// main reaches sink in 2, 3 and 4 calls, once through each of a, b and x.
+// main calls a on two lines, and b and c call each other. lonely reaches
+// island but not sink.
+static void TestPaths() {
+    std::vector<CompactEdge> Edges;
+    auto Call = [&](const char *Caller, const char *Callee, unsigned Line) {
+        Edges.push_back({Intern(Caller), Intern(Callee), Line, 0});
+    };
+    Call("main", "a", 1);
+    Call("main", "a", 2);
+    Call("main", "b", 3);
+    Call("main", "x", 4);
+    Call("a", "sink", 10);
+    Call("b", "c", 20);
+    Call("c", "b", 30);
+    Call("c", "sink", 31);
+    Call("x", "y", 40);
+    Call("y", "z", 50);
+    Call("z", "sink", 60);
+    Call("lonely", "island", 70);
+
+    CompactCallGraph Graph;
+    Graph.Build(Edges);
+    FunctionID Main = Graph.Find("main"), Sink = Graph.Find("sink");
+    FunctionID X = Graph.Find("x"), Lonely = Graph.Find("lonely");
+
+    PathQuery Query(Graph);
+    CallPath Path;
+
+    // Shortest path, unbounded and bounded
+    Expect(Query.ShortestPath(Main, Sink, 0, Path), "no shortest path from main");
+    ExpectPath(Graph, Path, "main -> a (line 1) -> sink (line 10)");
+    Expect(Query.ShortestPath(Main, Sink, 2, Path), "no shortest path from main within 2 calls");
+    Expect(!Query.ShortestPath(Main, Sink, 1, Path), "a path from main to sink within 1 call");
+    Expect(Query.ShortestPath(X, Sink, 0, Path), "no shortest path from x");
+    ExpectPath(Graph, Path, "x -> y (line 40) -> z (line 50) -> sink (line 60)");
+    Expect(!Query.ShortestPath(X, Sink, 2, Path), "a path from x to sink within 2 calls");
+
+    // All simple paths, shortest first, the second call to a not giving a
+    // path of its own and the b <-> c cycle not being followed
+    PathQueryOptions Options;
+    Options.MaxPaths = 10;
+    std::vector<CallPath> Paths;
+    Expect(Query.EnumeratePaths(Main, Sink, Options, Paths), "enumeration did not finish");
+    Expect(Paths.size() == 3, "found " + std::to_string(Paths.size()) + " paths from main, expected 3");
+    if (Paths.size() == 3) {
+        ExpectPath(Graph, Paths[0], "main -> a (line 1) -> sink (line 10)");
+        ExpectPath(Graph, Paths[1], "main -> b (line 3) -> c (line 20) -> sink (line 31)");
+        ExpectPath(Graph, Paths[2], "main -> x (line 4) -> y (line 40) -> z (line 50) -> sink (line 60)");
+    }
+
+    // The first K only
+    Options.MaxPaths = 2;
+    Query.EnumeratePaths(Main, Sink, Options, Paths);
+    Expect(Paths.size() == 2, "found " + std::to_string(Paths.size()) + " paths with MaxPaths 2");
+    if (Paths.size() == 2)
+        ExpectPath(Graph, Paths[1], "main -> b (line 3) -> c (line 20) -> sink (line 31)");
+
+    // MaxDepth leaves out the path through x
+    Options.MaxPaths = 10;
+    Options.MaxDepth = 3;
+    Query.EnumeratePaths(Main, Sink, Options, Paths);
+    Expect(Paths.size() == 2, "found " + std::to_string(Paths.size()) + " paths within 3 calls");
+    Options.MaxDepth = 1;
+    Query.EnumeratePaths(Main, Sink, Options, Paths);
+    Expect(Paths.empty(), "found a path within 1 call");
+
+    // Unreachable sink
+    Options.MaxDepth = 0;
+    Expect(!Query.ShortestPath(Lonely, Sink, 0, Path), "a path from lonely to sink");
+    Expect(!Query.ShortestPath(Sink, Main, 0, Path), "a path from sink to main");
+    Expect(Query.EnumeratePaths(Lonely, Sink, Options, Paths), "enumeration from lonely did not finish");
+    Expect(Paths.empty(), "found a path from lonely to sink");
+}
+
+// Layers of two functions each calling both functions of the next layer
+// give 2^Layers paths from src to dst, far more than the budget allows.
+static void TestTimeBudget() {
+    const unsigned Layers = 24;
+    std::vector<CompactEdge> Edges;
+    auto Name = [](unsigned Layer, unsigned i) {
+        return Intern("l" + std::to_string(Layer) + "_" + std::to_string(i));
+    };
+    for (unsigned i = 0; i < 2; ++i) {
+        Edges.push_back({Intern("src"), Name(0, i), 0, 0});
+        Edges.push_back({Name(Layers - 1, i), Intern("dst"), 0, 0});
+        for (unsigned Layer = 0; Layer + 1 < Layers; ++Layer) {
+            for (unsigned j = 0; j < 2; ++j)
+                Edges.push_back({Name(Layer, i), Name(Layer + 1, j), 0, 0});
+        }
+    }
+
+    CompactCallGraph Graph;
+    Graph.Build(Edges);
+    FunctionID Src = Graph.Find("src"), Dst = Graph.Find("dst");
+
+    PathQuery Query(Graph);
+    PathQueryOptions Options;
+    Options.MaxPaths = ~0u;
+    Options.TimeBudgetMs = 1;
+    std::vector<CallPath> Paths;
+    Expect(!Query.EnumeratePaths(Src, Dst, Options, Paths), "enumerated 2^24 paths within 1 ms");
+
+    // A query after the budget ran out starts from a clean state
+    Options.MaxPaths = 1;
+    Options.TimeBudgetMs = 0;
+    Expect(Query.EnumeratePaths(Src, Dst, Options, Paths), "enumeration after a timeout did not finish");
+    Expect(Paths.size() == 1 && Paths[0].Edges.size() == Layers + 1,
+           "no path of " + std::to_string(Layers + 1) + " calls after a timeout");
+}
+
+int main() {
+    TestPaths();
+    TestTimeBudget();
+    std::cout << "wrong: " << Wrong << std::endl;
+    return Wrong ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CompactCallGraph.h"
+#include "SymbolTable.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Build a random call graph of N functions (g<i>) with about N * Degree
+// calls. Most calls go from a lower to a higher index, which leaves chains
+// and fan-outs for the DAG; the rest go backwards and close cycles. A ring
+// over RingSize random functions adds one component at least that large.
+inline void BuildRandomGraph(std::mt19937 &Rng, unsigned N, unsigned Degree, unsigned RingSize,
+                             CompactCallGraph &Graph) {
+    std::vector<SymbolID> Names(N);
+    for (unsigned i = 0; i < N; ++i)
+        Names[i] = Intern("g" + std::to_string(i));
+
+    std::vector<CompactEdge> Edges;
+    std::uniform_int_distribution<unsigned> Pick(0, N - 1);
+    std::uniform_int_distribution<unsigned> Percent(0, 99);
+    for (unsigned i = 0; i < N; ++i) {
+        for (unsigned d = 0; d < Degree; ++d) {
+            unsigned j = Pick(Rng);
+            // Turn all but 3% of the backward calls around
+            if (j < i && Percent(Rng) >= 3)
+                Edges.push_back({Names[j], Names[i], d, 0});
+            else
+                Edges.push_back({Names[i], Names[j], d, 0});
+        }
+    }
+
+    std::vector<unsigned> Ring(N);
+    for (unsigned i = 0; i < N; ++i)
+        Ring[i] = i;
+    std::shuffle(Ring.begin(), Ring.end(), Rng);
+    for (unsigned i = 0; i < RingSize && RingSize <= N; ++i)
+        Edges.push_back({Names[Ring[i]], Names[Ring[(i + 1) % RingSize]], 0, 0});
+
+    Graph.Build(Edges);
+}
@@ -0,0 +1,79 @@
+// reachability-test: Build the reachability index of random cyclic call
+// graphs and check Reaches() against a BFS from every source (a sample of
+// sources on the large graph, whose index is built with several threads).
+//
+// usage: reachability-test [seed]   (default: 1)
+
+#include "RandomGraph.h"
+#include "Reachability.h"
+
+#include <cstdlib>
+#include <iostream>
+
+// Mark every function reachable from From
+static void BFS(const CompactCallGraph &Graph, FunctionID From, std::vector<char> &Reached) {
+    Reached.assign(Graph.NumFunctions(), 0);
+    std::vector<FunctionID> Worklist{From};
+    Reached[From] = 1;
+    while (!Worklist.empty()) {
+        FunctionID F = Worklist.back();
+        Worklist.pop_back();
+        for (FunctionID Callee : Graph.Callees(F)) {
+            if (!Reached[Callee]) {
+                Reached[Callee] = 1;
+                Worklist.push_back(Callee);
+            }
+        }
+    }
+}
+
+// Compare the index with BFS for NumSources sources spread over the graph.
+// Returns the number of wrong answers.
+static unsigned Check(const CompactCallGraph &Graph, unsigned NumThreads, unsigned NumSources) {
+    ReachabilityIndex Index;
+    Index.Build(Graph, NumThreads);
+
+    size_t N = Graph.NumFunctions();
+    unsigned Stride = NumSources < N ? N / NumSources : 1;
+    unsigned Wrong = 0;
+    std::vector<char> Reached;
+    for (FunctionID From = 0; From < N; From += Stride) {
+        BFS(Graph, From, Reached);
+        for (FunctionID To = 0; To < N; ++To) {
+            if (Index.Reaches(From, To) == bool(Reached[To]))
+                continue;
+            if (++Wrong <= 5)
+                std::cerr << "error: Reaches(" << Graph.Name(From).str() << ", " << Graph.Name(To).str()
+                          << ") is " << !Reached[To] << std::endl;
+        }
+    }
+
+    std::cout << "functions: " << N << "  calls: " << Graph.NumEdges()
+              << "  components: " << Index.getCondensation().NumComponents()
+              << "  queries: " << Index.NumQueries() << "  searches: " << Index.NumSearches()
+              << "  wrong: " << Wrong << std::endl;
+    return Wrong;
+}
+
+int main(int argc, char **argv) {
+    unsigned Seed = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+    std::mt19937 Rng(Seed);
+
+    unsigned Wrong = 0;
+    for (unsigned N : {50, 300, 1000}) {
+        for (unsigned Degree : {1, 2, 4}) {
+            for (unsigned RingSize : {0u, N / 4}) {
+                CompactCallGraph Graph;
+                BuildRandomGraph(Rng, N, Degree, RingSize, Graph);
+                Wrong += Check(Graph, 1, N);
+            }
+        }
+    }
+
+    // Large enough for the condensation to split the work between threads
+    CompactCallGraph Graph;
+    BuildRandomGraph(Rng, 20000, 2, 6000, Graph);
+    Wrong += Check(Graph, 4, 50);
+
+    return Wrong ? 1 : 0;
+}
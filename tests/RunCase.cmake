@@ -0,0 +1,81 @@
+# Run one golden-output case: build CASE.bc from CASE.c, run kanalyzer on it
+# and compare the call graph with CASE.edges. Wall time and peak memory of
+# the run are reported as CTest measurements and written to perf.json.
+# With STDOUT=ON the graph is written to stdout (-o -), which then has to
+# hold nothing but the graph.
+#
+# cmake -DCASE=<name> -DCASE_DIR=<dir> -DWORK_DIR=<dir> -DKANALYZER=<path>
+#       [-DCLANG=<path>] [-DSTDOUT=ON] -P RunCase.cmake
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# A CASE.bc made with the case's Makefile is used as is
+if(EXISTS ${CASE_DIR}/${CASE}.bc)
+    set(Bitcode ${CASE_DIR}/${CASE}.bc)
+elseif(CLANG)
+    set(Bitcode ${WORK_DIR}/${CASE}.bc)
+    execute_process(
+        COMMAND ${CLANG} -c ${CASE}.c -O0 -emit-llvm -g -o ${Bitcode}
+        WORKING_DIRECTORY ${CASE_DIR}
+        RESULT_VARIABLE Result)
+    if(NOT Result EQUAL 0)
+        message(FATAL_ERROR "${CASE}: compiling ${CASE}.c failed")
+    endif()
+else()
+    message("SKIPPED: ${CASE}: no clang to build ${CASE}.c and no ${CASE}.bc")
+    return()
+endif()
+
+set(Edges ${WORK_DIR}/${CASE}.txt)
+set(StatsReport ${WORK_DIR}/stats.json)
+if(STDOUT)
+    execute_process(
+        COMMAND ${KANALYZER} -o - -output-format=text -stats-report=${StatsReport} ${Bitcode}
+        OUTPUT_FILE ${Edges}
+        ERROR_FILE ${WORK_DIR}/kanalyzer.log
+        RESULT_VARIABLE Result)
+else()
+    execute_process(
+        COMMAND ${KANALYZER} -o ${Edges} -output-format=text -stats-report=${StatsReport} ${Bitcode}
+        OUTPUT_FILE ${WORK_DIR}/kanalyzer.log
+        ERROR_FILE ${WORK_DIR}/kanalyzer.log
+        RESULT_VARIABLE Result)
+endif()
+if(NOT Result EQUAL 0)
+    file(READ ${WORK_DIR}/kanalyzer.log Log)
+    message(FATAL_ERROR "${CASE}: kanalyzer failed (${Result}):\n${Log}")
+endif()
+
+# Compare as sets of lines; '#' lines of the golden file are comments
+file(STRINGS ${CASE_DIR}/${CASE}.edges Expected REGEX "^[^#]")
+file(STRINGS ${Edges} Actual)
+list(SORT Expected)
+list(SORT Actual)
+if(NOT "${Expected}" STREQUAL "${Actual}")
+    set(Missing ${Expected})
+    set(Unexpected ${Actual})
+    if(Actual)
+        list(REMOVE_ITEM Missing ${Actual})
+    endif()
+    if(Expected)
+        list(REMOVE_ITEM Unexpected ${Expected})
+    endif()
+    string(REPLACE ";" "\n  " Missing "${Missing}")
+    string(REPLACE ";" "\n  " Unexpected "${Unexpected}")
+    message(FATAL_ERROR "${CASE}: call graph differs from ${CASE}.edges\n"
+                        "missing edges:\n  ${Missing}\n"
+                        "unexpected edges:\n  ${Unexpected}")
+endif()
+
+file(READ ${StatsReport} Report)
+string(REGEX MATCH "\"wall_ms\": ([0-9.eE+-]+)" Match "${Report}")
+set(WallMs ${CMAKE_MATCH_1})
+string(REGEX MATCH "\"peak_rss_kb\": ([0-9]+)" Match "${Report}")
+set(PeakRSS ${CMAKE_MATCH_1})
+list(LENGTH Actual NumEdges)
+
+message("<DartMeasurement name=\"wall_ms\" type=\"numeric/double\">${WallMs}</DartMeasurement>")
+message("<DartMeasurement name=\"peak_rss_kb\" type=\"numeric/integer\">${PeakRSS}</DartMeasurement>")
+file(WRITE ${WORK_DIR}/perf.json
+     "{\"case\": \"${CASE}\", \"edges\": ${NumEdges}, \"wall_ms\": ${WallMs}, \"peak_rss_kb\": ${PeakRSS}}\n")
+message("${CASE}: ${NumEdges} edges match, ${WallMs} ms, peak RSS ${PeakRSS} kB")